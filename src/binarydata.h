@@ -0,0 +1,112 @@
+#ifndef BINARYDATA_H
+#define BINARYDATA_H
+
+#include "main.h"
+#include <stdint.h>
+
+// FNV-1a, to tell if the data is still what was written
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline void HashBytes(uint64_t& Hash, const char* Data, cszt Size)
+{
+  for (szt i = 0; i < Size; ++i) {
+    Hash ^= (uchar)Data[i];
+    Hash *= FNV_PRIME;
+  }
+}
+
+/** all numbers are written little endian one byte at a time so the data
+  * doesn't depend on the alignment or byte order of the machine
+  */
+inline void PutU32(string& Out, const uint32_t Value)
+{
+  for (szt i = 0; i < 4; ++i) {
+    Out += (char)((Value >> (8 * i)) & 0xFF);
+  }
+}
+
+inline void PutU64(string& Out, const uint64_t Value)
+{
+  for (szt i = 0; i < 8; ++i) {
+    Out += (char)((Value >> (8 * i)) & 0xFF);
+  }
+}
+
+inline void PutString(string& Out, const text_view& Text)
+{
+  PutU32(Out, Text.size());
+  Out.append(Text.Data, Text.Size);
+}
+
+/** @brief Bounds checked cursor over mapped binary data
+  */
+struct BinaryReader {
+  BinaryReader(const char* aData, cszt aSize, cszt aPos = 0)
+    : Data(aData), Size(aSize), Pos(aPos) { };
+
+  uint32_t U32()
+  {
+    uint32_t value = 0;
+    if (Pos + 4 > Size) {
+      Failed = true;
+      return value;
+    }
+    for (szt i = 0; i < 4; ++i) {
+      value |= (uint32_t)(uchar)Data[Pos++] << (8 * i);
+    }
+    return value;
+  };
+
+  uint64_t U64()
+  {
+    uint64_t value = 0;
+    if (Pos + 8 > Size) {
+      Failed = true;
+      return value;
+    }
+    for (szt i = 0; i < 8; ++i) {
+      value |= (uint64_t)(uchar)Data[Pos++] << (8 * i);
+    }
+    return value;
+  };
+
+  uchar U8()
+  {
+    if (Pos + 1 > Size) {
+      Failed = true;
+      return 0;
+    }
+    return (uchar)Data[Pos++];
+  };
+
+  void Str(string& Text)
+  {
+    cszt length = U32();
+    if (Failed || Pos + length > Size) {
+      Failed = true;
+      return;
+    }
+    Text.assign(Data + Pos, length);
+    Pos += length;
+  };
+
+  /** the text points into the data, which has to outlive it */
+  void Str(text_view& Text)
+  {
+    cszt length = U32();
+    if (Failed || Pos + length > Size) {
+      Failed = true;
+      return;
+    }
+    Text = text_view(Data + Pos, length);
+    Pos += length;
+  };
+
+  const char* Data;
+  szt Size;
+  szt Pos;
+  bool Failed = false;
+};
+
+#endif // BINARYDATA_H
@@ -3,9 +3,22 @@
 #include "tokens.h"
 #include "storyquery.h"
 #include "disk.h"
+#include "storycache.h"
+#include "workpool.h"
+#include "storylexer.h"
+#include "library.h"
+#include <ctime>
+#include <algorithm>
 
 const string FIRST_PLAY = "First Playthrough";
 cszt HISTORY_PAGE = 200;
+// turns played before the session is saved without being asked to
+cszt AUTOSAVE_TURNS = 10;
+#ifdef DEVBUILD
+// turns played by the check and the seed that picks them
+cszt CHECK_TURNS = 500;
+const uint CHECK_SEED = 7;
+#endif
 
 Book::Book()
 {
@@ -70,7 +83,7 @@ bool Book::RedoSnapshot()
   cszt next = BookSession.CurrentSnapshot;
   // be careful not to overshoot because that will reset the story
   if (next < BookSession.Snapshots.size()) {
-    return LoadSnapshot(next);
+    return StepSnapshot(next);
   }
   return false;
 }
@@ -82,11 +95,23 @@ bool Book::UndoSnapshot()
   // only load the snapshot if it's not the 0th step, which is the start
   // of the book before values existed to be loaded
   if (prev > 0) {
-    return LoadSnapshot(prev);
+    return StepSnapshot(prev);
   }
   return false;
 }
 
+/** @brief Move to the snapshot next to the current one by only replacing
+  * the values that differ, loads it in full if the session can't do that
+  */
+bool Book::StepSnapshot(cszt SnapshotIndex)
+{
+  if (!StepSnapshots || !BookSession.StepSnapshot(SnapshotIndex)) {
+    return LoadSnapshot(SnapshotIndex);
+  }
+  ActiveBranch = (SnapshotIndex == BookSession.Snapshots.size() - 1);
+  return true;
+}
+
 bool Book::LoadSnapshot(cszt SnapshotIndex)
 {
   // before loading, revert to book values
@@ -155,7 +180,8 @@ void Book::CloseBook()
 Properties Book::GetBooks()
 {
   Properties result;
-  result.TextValues = Disk::ListFiles(STORY_DIR);
+  result.TextValues = Library::ListFiles(STORY_DIR);
+  Library::Save(Writer);
   return result;
 }
 
@@ -177,70 +203,81 @@ bool Book::OpenStory(const string& Path,
                      Story& MyStory)
 {
   MyStory.Reset();
-  vector<string> filenames = Disk::ListFiles(Path, STORY_EXT);
+  vector<string> filenames = Library::ListFiles(Path, STORY_EXT);
   filenames.push_back(STORY_FILE);
 
-  // go through all *.story files but read story first
-  szt i = filenames.size();
-  while (i) { // reverse for loop
-    const string& filename = filenames[--i];
-    string textBlock;
-    string buffer;
-    File story;
-    story.Read(Path + SLASH + filename);
-
-    while (!story.Empty()) {
-      story.GetLine(buffer);
-      StripComments(buffer);
-      if (buffer.empty()) {
-        continue;
-      }
-      // look for a keyword definition or asset definition
-      if (buffer.size() > 2
-          && buffer[0] == token::Start[token::noun]
-          && buffer[1] != token::Start[token::scope]) {
-        szt nounPos = FindTokenEnd(buffer, token::noun);
-        if (string::npos != nounPos) { // [noun]
-          if (!textBlock.empty()) {
-            // if it's the second keyword we hit on this run
-            // parse the text and start a new run
-            MyStory.ParseKeywordDefinition(textBlock);
-            textBlock.clear();
-          }
-          textBlock += buffer;
-        } else {
-          LOG(buffer + " - malformed noun definition")
-        }
-      } else if (buffer[0] == token::Start[token::asset]) {
-        AddAssetDefinition(buffer);
-      } else if (!textBlock.empty()) {
-        // we didn't find a keyword, keep adding lines if we already hit one
-        textBlock += " "; // replace new lines with spaces
-        textBlock += buffer;
-      }
-    }
+  // use the compiled image if the sources haven't changed since it was made
+  const string& cacheFilename = Path + SLASH + STORY_FILE + STORY_CACHE_EXT;
+  const uint64_t sourceHash = StoryCache::HashSources(Path, filenames);
+  cszt firstAsset = Assets.size();
+  const bool cached = StoryCache::Load(cacheFilename, sourceHash, MyStory,
+                                       Assets);
+  if (!cached) {
+    ReadStory(Path, filenames, MyStory);
+  }
+  MyStory.Fixate();
 
-    // last keyword definition
-    if (!textBlock.empty()) {
-      MyStory.ParseKeywordDefinition(textBlock);
-    }
+  // pages get parsed on first use but the rest are parsed in the background
+  // and the image gets saved once they're all done
+  const vector<string_pair> storyAssets(Assets.begin() + firstAsset,
+                                        Assets.end());
+  if (!MyStory.IsParsed() && STORY_WARM_UP) {
+    MyStory.WarmUp([cacheFilename, sourceHash, storyAssets, &MyStory]() {
+      StoryCache::Save(cacheFilename, sourceHash, MyStory, storyAssets);
+    });
+  } else if (!cached) {
+    StoryCache::Save(cacheFilename, sourceHash, MyStory, storyAssets);
   }
+  // keep the listings and hashes for the next time
+  Library::Save(Writer);
 
-  MyStory.Fixate();
   return true;
 }
 
+/** @brief Read all the *.story files and add their definitions to the story
+  */
+void Book::ReadStory(const string& Path,
+                     const vector<string>& Filenames,
+                     Story& MyStory)
+{
+  // files are read in parallel and only their contents kept in order
+  cszt numFiles = Filenames.size();
+  vector<vector<string>> definitions(numFiles);
+  vector<vector<string>> assetTexts(numFiles);
+  WorkPool::Run(numFiles, [&](szt i) {
+    StoryLexer::ReadFile(Path + SLASH + Filenames[i], definitions[i],
+                         assetTexts[i]);
+  });
+
+  // go through all *.story files but read story first
+  vector<string> storyTexts;
+  szt i = numFiles;
+  while (i) { // reverse for loop
+    --i;
+    for (const string& assetText : assetTexts[i]) {
+      AddAssetDefinition(assetText);
+    }
+    storyTexts.insert(storyTexts.end(), definitions[i].begin(),
+                      definitions[i].end());
+  }
+  MyStory.ParseKeywordDefinitions(storyTexts);
+}
+
 void Book::InitSession(Story& MyStory,
                        Session& MySession)
 {
   MySession.BookName = BookTitle;
   MySession.UserValues.clear();
   MySession.AssetStates.clear();
+  MySession.ClearVerbs();
+  // the values are back to the start of the book
+  MySession.LoadedSnapshot = 0;
   // initialise reserved keywords
   for (szt i = 0; i < SYSTEM_NOUN_MAX; ++i) {
     const string& name = SystemNounNames[i];
     const Properties& systemValues = MyStory.FindPage(name).PageValues;
-    Properties& sysNoun = MySession.UserValues[SystemNounNames[i]];
+    const uint symbol = MySession.Symbols.Add(name);
+    Properties& sysNoun = MySession.AddUserValues(symbol);
     sysNoun.AddValues(systemValues);
     // and set the pointers to system nouns for easy (read only) access
     MySession.SystemNouns[i] = &sysNoun;
@@ -312,11 +349,17 @@ const string Book::GetMenuVerbs(const string& Noun)
   StoryQuery query(*this, MenuStory, GameSession, text);
   return query.GetVerbs(Noun).PrintKeywordList("\n");
 }
+/** @brief Get the menu values of the noun to watch for changes, they're
+  * not part of any snapshot so they don't get marked as changed
+  */
 Properties& Book::GetMenuValues(const string& Noun)
 {
   string text; // discarded
   StoryQuery query(*this, MenuStory, GameSession, text);
-  return query.GetUserValues(Noun);
+  Properties& values = query.AddUserValues(Noun);
+  // the reader may still write to them so don't trust verbs cached before
+  GameSession.TouchValues(GameSession.Symbols.Find(Noun));
+  return values;
 }
 
 /** @brief If the first element of the pair is a complete action
@@ -380,6 +423,10 @@ void Book::SetMenuAction(const string_pair& Choice)
 string Book::ProcessStoryQueue()
 {
   BookSession.CreateSnapshot();
+  if (SessionOpen && ++UnsavedTurns >= AUTOSAVE_TURNS) {
+    // only builds the records, the writer does the rest in the background
+    SaveSession();
+  }
   return ProcessQueue(BookStory, BookSession);
 }
 
@@ -442,6 +489,7 @@ const string Book::ProcessQueue(Story& MyStory,
   }
 
   actions.Reset();
+  Scratch.EndTurn();
   return pageText;
 }
 
@@ -460,12 +508,11 @@ string Book::GetQuickMenu()
 bool Book::NewSession()
 {
   if (BookOpen) {
-    const string& path = STORY_DIR + SLASH + BookTitle;
     // get unique filename and session name
-    BookSession.Filename = GetFreeSessionFilename(path);
-    const vector<string_pair>& namemap = GetSessionNamemap(path);
+    const SessionCatalog& catalog = GetCatalog(BookTitle);
+    BookSession.Filename = catalog.GetFreeFilename();
     BookSession.Name = FIRST_PLAY;
-    MakeSessionNameUnique(BookSession.Name, namemap);
+    catalog.MakeNameUnique(BookSession.Name);
     return LoadSession(BookSession.Name);
   }
   return false;
@@ -484,136 +531,86 @@ bool Book::LoadSession(const string& SessionName)
     }
     SessionOpen = true;
     InitSession(BookStory, BookSession);
-    const string& path = STORY_DIR + SLASH + BookTitle;
-    // if no filename use the continue file to find the filename
+    const SessionCatalog& catalog = GetCatalog(BookTitle);
+    // if no filename continue the session saved last
     if (SessionName.empty()) {
-      const string& sessionMap = path + SLASH + SESSION_MAP;
-      if (Disk::Exists(sessionMap)) {
-        // continue from the first file in the map file
-        File continueFile;
-        continueFile.Read(sessionMap);
-        continueFile.GetLine(BookSession.Filename);
-        return BookSession.Load();
+      if (!catalog.Entries.empty()) {
+        BookSession.Filename = catalog.Entries.front().Filename;
+        return BookSession.Load(Writer);
       } else {
         NewSession();
       }
     } else {
       // try and load the session if it already exists
-      const vector<string_pair>& namemap = GetSessionNamemap(path);
-      for (const string_pair& existingName : namemap) {
-        if (SessionName == existingName.Y) {
-          BookSession.Filename = existingName.X;
-          return BookSession.Load();
-        }
+      const SessionEntry* entry = catalog.Find(SessionName);
+      if (entry) {
+        BookSession.Filename = entry->Filename;
+        return BookSession.Load(Writer);
+      } else {
+        // session name not found so it's the first play-through or a new
+        // game, session already initialised, no loading needed, add start
+        // bookmark
+        Bookmark& mark = BookSession.CreateBookmark();
+        mark.Description = "Story beginning";
+        return true;
       }
-      // session name not found so it's the first play-through or a new game
-      // session already initialised, no loading needed, add start bookmark
-      Bookmark& mark = BookSession.CreateBookmark();
-      mark.Description = "Story beginning";
-      return true;
     }
   }
   return false;
 }
 
-/** @brief Return the session names that are stored in the session name map
+/** @brief Return the session names from the catalog of the book
   */
 Properties Book::GetSessions(const string& Title)
 {
   Properties result;
-  string path = STORY_DIR + SLASH;
-  if (Title.empty()) {
-    if (BookOpen) {
-      path += BookTitle;
-    } else {
-      // no book open, don't know where to look for sessions
-      return result;
-    }
-  } else {
-    path += Title;
+  if (Title.empty() && !BookOpen) {
+    // no book open, don't know where to look for sessions
+    return result;
   }
-  // load the names of sessions from the meta file
-  const vector<string_pair>& namemap = GetSessionNamemap(path);
-  for (const string_pair& name : namemap) {
-    result.AddValue(name.Y);
+  const SessionCatalog& catalog = GetCatalog(Title.empty() ? BookTitle
+                                              : Title);
+  for (const SessionEntry& entry : catalog.Entries) {
+    result.AddValue(entry.Name);
   }
   return result;
 }
 
-/** @brief get a list of pairs of filename and session name from the map file
-  */
-const vector<string_pair> Book::GetSessionNamemap(const string& Path)
-{
-  vector<string_pair> namemap;
-  const vector<string>& files = Disk::ListFiles(Path, SESSION_EXT, true);
-  if (files.empty()) {
-    return namemap;
-  }
-  const string mapFilename = Path + SLASH + SESSION_MAP;
-  if (Disk::Exists(mapFilename)) {
-    File filemap;
-    filemap.Read(mapFilename);
-    // read the file and name pairs from the session file but only add
-    // the ones that also exist as filename in the folder
-    string existingFilename, sessionName;
-    while (filemap.GetLine(existingFilename)) {
-      filemap.GetLine(sessionName);
-      for (const string& filename : files) {
-        if (existingFilename == filename) {
-          namemap.push_back(string_pair(existingFilename, sessionName));
-          break;
-        }
-      }
-    }
-  }
-  return namemap;
-}
-
-/** @brief Mangle the name so it's unique based on the name map
-  * \return false if the name was already unique
+/** @brief The catalog is read from the folder of the book the first time
+  * it's needed and kept up to date by saving from then on
   */
-bool Book::MakeSessionNameUnique(string& Name,
-                                 const vector<string_pair>& Namemap)
+SessionCatalog& Book::GetCatalog(const string& Title)
 {
-  bool dupeName = true;
-  const string originalName = Name;
-  szt i = 0;
-  // get a unique session name
-  while (dupeName) {
-    if (i) {
-      Name = originalName + IntoString(++i);
-    } else {
-      ++i;
-    }
-    dupeName = false;
-    for (const string_pair& existingName : Namemap) {
-      if (Name == existingName.Y) {
-        dupeName = true;
-      }
-    }
+  const auto it = Catalogs.find(Title);
+  if (it != Catalogs.end()) {
+    return it->second;
   }
-  return i;
+  // the folder has to have everything queued for it before it's listed
+  Writer.Flush();
+  SessionCatalog& catalog = Catalogs[Title];
+  catalog.Load(STORY_DIR + SLASH + Title);
+  return catalog;
 }
 
-/** @brief Save current session, trim the excess and rename
+/** @brief Save current session, trim the excess and rename, the new file
+  * refers to the old one for the history they share
   */
 bool Book::BranchSession(const string& NewName)
 {
   if (SessionOpen) {
     SaveSession();
-    BookSession.Trim();
+    BookSession.Branch();
     ActiveBranch = true;
     // create unique names
-    const string& path = STORY_DIR + SLASH + BookTitle;
-    BookSession.Filename = GetFreeSessionFilename(path);
-    const vector<string_pair>& namemap = GetSessionNamemap(path);
+    const SessionCatalog& catalog = GetCatalog(BookTitle);
+    BookSession.Filename = catalog.GetFreeFilename();
     const string& turn = IntoString(BookSession.CurrentSnapshot - 1);
     if (NewName.empty() || NewName == BookSession.Name) {
       BookSession.Name = BookSession.Name + " T" + turn + " branch";
     } else {
       BookSession.Name = NewName;
     }
-    MakeSessionNameUnique(BookSession.Name, namemap);
+    catalog.MakeNameUnique(BookSession.Name);
     SaveSession();
     return true;
   }
@@ -625,28 +622,25 @@ bool Book::SaveSession(const string& NewName)
   if (SessionOpen) {
     const string& path = STORY_DIR + SLASH + BookTitle + SLASH;
     const string& filename = path + BookSession.Filename + ".session";
-    const vector<string_pair>& namemap = GetSessionNamemap(path);
+    SessionCatalog& catalog = GetCatalog(BookTitle);
     if (!NewName.empty() && BookSession.Name != NewName) {
       BookSession.Name = NewName;
-      MakeSessionNameUnique(BookSession.Name, namemap);
+      catalog.MakeNameUnique(BookSession.Name);
     }
-    Disk::Write(filename, BookSession.GetSessionText());
-    // write the meta information for all the session files
-    string meta = BookSession.Filename;
-    meta += '\n';
-    meta += BookSession.Name;
-    meta += '\n';
-    for (const string_pair& name : namemap) {
-      if (name.X != BookSession.Filename) {
-        meta += name.X;
-        meta += '\n';
-        meta += name.Y;
-        meta += '\n';
-      }
+    BookSession.Save(filename, Writer);
+    UnsavedTurns = 0;
+    // keep what the menus show about it and make it the session to continue
+    SessionEntry entry;
+    entry.Filename = BookSession.Filename;
+    entry.Name = BookSession.Name;
+    const szt snapshots = BookSession.Snapshots.size();
+    entry.Turns = snapshots > 1 ? snapshots - 1 : 0;
+    entry.Modified = time(NULL);
+    if (!BookSession.Bookmarks.empty()) {
+      entry.LastBookmark = BookSession.Bookmarks.rbegin()->second.Description;
     }
-    // save this filename as the last used session
-    const string& continueFilename = path + SESSION_MAP;
-    Disk::Write(continueFilename, meta);
+    catalog.Update(entry);
+    catalog.Save(Writer);
     return true;
   }
   return false;
@@ -661,25 +655,187 @@ const string Book::GetSessionName()
 const string Book::ShowVariables()
 {
   string variables;
-  for (const auto& value : BookSession.UserValues) {
-    variables += value.first;
+  vector<uint> nouns;
+  for (szt i = 0, fSz = BookSession.UserValues.size(); i < fSz; ++i) {
+    if (BookSession.UserValues[i]) {
+      nouns.push_back(i);
+    }
+  }
+  BookSession.Symbols.SortByName(nouns);
+  for (const uint symbol : nouns) {
+    variables += BookSession.Symbols.GetName(symbol);
     variables +=  ": ";
-    variables += value.second.PrintValues();
+    variables += BookSession.UserValues[symbol]->PrintValues();
     variables +=  '\n';
   }
   return variables;
 }
-#endif
 
-const string Book::GetFreeSessionFilename(const string& Path)
+/** @brief Play the open book without a session file, picking actions,
+  * undoing and redoing at random but the same way for the same seed
+  * \param ChangedTurns how many of the turns changed any values
+  * \return the pages, traces and values after every turn
+  */
+const string Book::PlayRandomTurns(cszt Turns, uint Seed, szt& ChangedTurns)
 {
-  szt i = 1;
-  while (Disk::Exists(Path + SLASH + IntoString(i) + SESSION_EXT)) {
-    ++i;
+  ChangedTurns = 0;
+  if (!BookOpen) {
+    return "";
+  }
+  BookSession.Reset();
+  InitSession(BookStory, BookSession);
+  ActiveBranch = true;
+  string transcript = ProcessStoryQueue();
+  string values = ShowVariables();
+  for (szt turn = 0; turn < Turns; ++turn) {
+    Seed = Seed * 1103515245 + 12345;
+    cszt roll = (Seed >> 16) % 10;
+    if (roll < 2) {
+      transcript += "\nUNDO\n";
+      UndoSnapshot();
+    } else if (roll < 3) {
+      transcript += "\nREDO\n";
+      RedoSnapshot();
+    } else {
+      // like the reader, acting in the past branches off from there
+      if (!ActiveBranch) {
+        BookSession.Trim();
+        ActiveBranch = true;
+      }
+      vector<string_pair> choices;
+      Properties nouns;
+      GetStoryNouns(nouns);
+      for (const string& noun : nouns.TextValues) {
+        const string& verbs = GetStoryVerbs(noun);
+        szt pos = 0;
+        while (pos < verbs.size()) {
+          szt end = FindCharacter(verbs, '\n', pos);
+          if (end == string::npos) {
+            end = verbs.size();
+          }
+          // the verbs are listed as <verb> keywords like the reader shows
+          // them, clicking one gives the verb without the brackets
+          if (end > pos + 2 && verbs[pos] == token::Start[token::keyword]
+              && verbs[end - 1] == token::End[token::keyword]) {
+            choices.push_back(string_pair(noun,
+                                          CutString(verbs, pos + 1, end - 1)));
+          }
+          pos = end + 1;
+        }
+      }
+      if (choices.empty()) {
+        break;
+      }
+      const string_pair& choice = choices[(Seed >> 8) % choices.size()];
+      transcript += "\n== " + choice.X + ":" + choice.Y + '\n';
+      SetStoryAction(choice);
+    }
+    // the reader runs whatever is queued, after an undo that's the action
+    // of the snapshot loaded
+    if (!IsActionQueueEmpty()) {
+      transcript += ProcessStoryQueue();
+      transcript += GTrace;
+    }
+    const string& turnValues = ShowVariables();
+    if (turnValues != values) {
+      ++ChangedTurns;
+      values = turnValues;
+    }
+    transcript += '\n';
+    transcript += values;
   }
-  return IntoString(i);
+  return transcript;
 }
 
+/** @brief Play the book the same way with undo and redo stepping through
+  * the values, with them loading the snapshots in full and with the verbs
+  * run from the verb code instead of the blocks, all have to show exactly
+  * the same
+  * \return false if any of them differed
+  */
+bool Book::CheckBook(const string& Title)
+{
+  // the pages and values the other ways of playing have to match
+  string expected;
+  const string checks[] = { "walker stepping undo", "full loads",
+                            "verb code" };
+  const bool useVerbCode = StoryQuery::UseVerbCode;
+  bool passed = true;
+  for (szt i = 0; i < 3; ++i) {
+    StoryQuery::UseVerbCode = i == 2;
+    Book book;
+    book.StepSnapshots = i != 1;
+    if (!book.OpenBook(Title)) {
+      LOG(Title + " - can't open the book to check");
+      passed = false;
+      break;
+    }
+    szt changedTurns;
+    const string& transcript = book.PlayRandomTurns(CHECK_TURNS, CHECK_SEED,
+                                                    changedTurns);
+    book.CloseBook();
+    if (!i) {
+      // turns that don't change anything don't check the undo or the code
+      if (!changedTurns) {
+        LOG(Title + " - no turn changed any values, nothing to check");
+        passed = false;
+        break;
+      }
+      LOG(Title + " - values changed in " + IntoString(changedTurns) + " of "
+          + IntoString(CHECK_TURNS) + " turns");
+      expected = transcript;
+    } else if (transcript != expected) {
+      // show the first line that differs
+      szt pos = 0;
+      while (pos < transcript.size() && transcript[pos] == expected[pos]) {
+        ++pos;
+      }
+      pos = pos ? expected.rfind('\n', pos - 1) : string::npos;
+      pos = pos == string::npos ? 0 : pos + 1;
+      const string& line = CutString(transcript, pos,
+                                     FindCharacter(transcript, '\n', pos));
+      const string& expectedLine = CutString(expected, pos,
+                                             FindCharacter(expected, '\n',
+                                                           pos));
+      LOG(Title + " - " + checks[i] + " differ from the " + checks[0]
+          + " at line "
+          + IntoString(count(expected.begin(), expected.begin() + pos, '\n')
+                       + 1) + ": " + line + " instead of " + expectedLine);
+      passed = false;
+    } else {
+      LOG(Title + " - " + checks[i] + " match the " + checks[0] + " in "
+          + IntoString(CHECK_TURNS) + " turns");
+    }
+  }
+  StoryQuery::UseVerbCode = useVerbCode;
+
+  // the story cache saved from the parsed story has to come out the same
+  // when saved again from the story loaded from it
+  const string& path = STORY_DIR + SLASH + Title;
+  const string& cacheFilename = path + SLASH + STORY_FILE + STORY_CACHE_EXT;
+  vector<string> filenames = Library::ListFiles(path, STORY_EXT);
+  filenames.push_back(STORY_FILE);
+  const uint64_t sourceHash = StoryCache::HashSources(path, filenames);
+  Book book;
+  Story parsed;
+  book.ReadStory(path, filenames, parsed);
+  parsed.Fixate();
+  parsed.ParsePages();
+  const string& image = StoryCache::GetImage(sourceHash, parsed, book.Assets);
+  Story loaded;
+  vector<string_pair> assets;
+  if (!StoryCache::Save(cacheFilename, sourceHash, parsed, book.Assets)
+      || !StoryCache::Load(cacheFilename, sourceHash, loaded, assets)
+      || StoryCache::GetImage(sourceHash, loaded, assets) != image) {
+    LOG(Title + " - the story cache differs between two saves");
+    passed = false;
+  } else {
+    LOG(Title + " - the story cache is the same in two saves");
+  }
+  return passed;
+}
+#endif
+
 void Book::GetSnapshots(Properties& SnapshotItems)
 {
   // find the range ending with the desired location
@@ -700,7 +856,8 @@ void Book::GetSnapshots(Properties& SnapshotItems)
     } else {
       // extract noun and verb
       string_pair action;
-      action.X = BookSession.QueueHistory[index - 1];
+      const uint queueI = BookSession.QueueHistory[index - 1];
+      action.X = BookSession.HistoryTexts.Get(queueI).str();
       GetChoice(action);
       // add as "1. verb noun"
       entry += action.Y + ' ' + action.X;
@@ -5,6 +5,9 @@
 #include "story.h"
 #include "session.h"
 #include "mediamanager.h"
+#include "scratcharena.h"
+#include "writequeue.h"
+#include "sessioncatalog.h"
 
 class Story;
 class Session;
@@ -80,12 +83,16 @@ public:
 
 #ifdef DEVBUILD
   const string ShowVariables();
+  const string PlayRandomTurns(cszt Turns, uint Seed, szt& ChangedTurns);
+  static bool CheckBook(const string& Title);
 #endif
 
 private:
   bool AddAssetDefinition(const string& StoryText);
   bool OpenMenu();
   bool OpenStory(const string& Path, Story& MyStory);
+  void ReadStory(const string& Path, const vector<string>& Filenames,
+                 Story& MyStory);
 
   const vector<string>& GetVerbs(const string& Noun, Story& MyStory,
                                  Session& MySession);
@@ -93,9 +100,8 @@ private:
   const string ProcessQueue(Story& MyStory, Session& MySession);
 
   void InitSession(Story& MyStory, Session& MySession);
-  const string GetFreeSessionFilename(const string& Path);
-  const vector<string_pair> GetSessionNamemap(const string& Path);
-  bool MakeSessionNameUnique(string& Name, const vector<string_pair>& Namemap);
+  bool StepSnapshot(cszt SnapshotIndex);
+  SessionCatalog& GetCatalog(const string& Title);
 
 
 public:
@@ -105,8 +111,13 @@ public:
   bool DialogOpen = false;
   bool SessionOpen = false;
   bool ActiveBranch = true;
+  // undo and redo only replace the values that differ, false loads the
+  // whole snapshot every time
+  bool StepSnapshots = true;
 
   vector<Dialog> Dialogs;
+  // temporaries of the queries, reused every turn
+  ScratchArena Scratch;
 
 private:
   Story MenuStory;
@@ -114,6 +125,12 @@ private:
 
   Story BookStory;
   Session BookSession;
+  // turns played since the session was last saved
+  szt UnsavedTurns = 0;
+  // session files are written in the background, flushed before reading
+  WriteQueue Writer;
+  // sessions of each book the menus have looked at, by title
+  map<string, SessionCatalog> Catalogs;
 
   MediaManager Media;
   vector<string_pair> Assets;
@@ -121,14 +138,13 @@ private:
 
 bool Book::GetAssetState(const string& AssetName)
 {
-  return BookSession.AssetStates[AssetName].Playing;
+  return BookSession.GetAssetState(AssetName);
 }
 
 void Book::SetAssetState(const string& AssetName, const bool Playing)
 {
-  if (BookSession.AssetStates[AssetName].Playing != Playing) {
+  if (BookSession.SetAssetState(AssetName, Playing)) {
     BookSession.AssetsChanged = true;
-    BookSession.AssetStates[AssetName].Playing = Playing;
   }
 }
 
@@ -1,11 +1,11 @@
 #include "buttonbox.h"
 #include "input.h"
-#include "disk.h"
+#include "library.h"
 
 Button::Button(const buttonType aFunction) : Function(aFunction)
 {
   const string& stem = ButtonTypeNames[Function];
-  vector<string> surfaceNames = Disk::GetFileSeries(BUTTONS_DIR, stem);
+  vector<string> surfaceNames = Library::GetFileSeries(BUTTONS_DIR, stem);
 
   ButtonSurfaces.resize(surfaceNames.size());
   for (szt i = 0, fSz = surfaceNames.size(); i < fSz; ++i) {
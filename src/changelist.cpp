@@ -0,0 +1,89 @@
+#include "changelist.h"
+
+void ChangeList::Add(cszt_pair& Change)
+{
+  if (Count % CHANGELIST_BLOCK == 0) {
+    Blocks.push_back(Data.size());
+  }
+  Encode(Change.X);
+  Encode(Change.Y);
+  ++Count;
+}
+
+szt_pair ChangeList::Get(cszt Index) const
+{
+  szt pos = Seek(Index);
+  szt_pair change;
+  change.X = Decode(pos);
+  change.Y = Decode(pos);
+  return change;
+}
+
+/** @brief Unpack the changes from Begin up to End into Changes
+  */
+void ChangeList::Read(cszt Begin,
+                      cszt End,
+                      vector<szt_pair>& Changes) const
+{
+  Changes.clear();
+  if (Begin >= End) {
+    return;
+  }
+  Changes.resize(End - Begin);
+  szt pos = Seek(Begin);
+  for (szt_pair& change : Changes) {
+    change.X = Decode(pos);
+    change.Y = Decode(pos);
+  }
+}
+
+/** @brief Drop the changes past aCount, it never adds any
+  */
+void ChangeList::Resize(cszt aCount)
+{
+  if (aCount >= Count) {
+    return;
+  }
+  Data.resize(Seek(aCount));
+  Blocks.resize((aCount + CHANGELIST_BLOCK - 1) / CHANGELIST_BLOCK);
+  Count = aCount;
+}
+
+/** @brief Seven bits at a time, the top bit set while more follow
+  */
+void ChangeList::Encode(szt Value)
+{
+  while (Value >= 0x80) {
+    Data.push_back((uchar)(Value | 0x80));
+    Value >>= 7;
+  }
+  Data.push_back((uchar)Value);
+}
+
+szt ChangeList::Decode(szt& Pos) const
+{
+  szt value = 0;
+  uint shift = 0;
+  uchar byte;
+  do {
+    byte = Data[Pos++];
+    value |= (szt)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+/** @brief Position in the data where the change starts
+  */
+szt ChangeList::Seek(cszt Index) const
+{
+  if (Index >= Count) {
+    return Data.size();
+  }
+  szt pos = Blocks[Index / CHANGELIST_BLOCK];
+  // skip the two numbers of every change before it in the block
+  for (szt i = Index % CHANGELIST_BLOCK * 2; i > 0; --i) {
+    while (Data[pos++] & 0x80) { }
+  }
+  return pos;
+}
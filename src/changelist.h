@@ -0,0 +1,61 @@
+#ifndef CHANGELIST_H
+#define CHANGELIST_H
+
+#include "main.h"
+
+// changes between the positions kept for seeking
+cszt CHANGELIST_BLOCK = 256;
+
+/** @brief Value changes of a session packed as variable length numbers
+  *
+  * Each change is the history a value was added to and its 1-based position
+  * in it, both small numbers that mostly take a byte each instead of the
+  * sixteen of a szt_pair. The start of every CHANGELIST_BLOCK changes is
+  * kept so getting at a change only decodes from the start of its block.
+  */
+class ChangeList
+{
+public:
+  ChangeList() { };
+  ~ChangeList() { };
+
+  void Add(cszt_pair& Change);
+  szt_pair Get(cszt Index) const;
+  void Read(cszt Begin, cszt End, vector<szt_pair>& Changes) const;
+  void Resize(cszt aCount);
+
+  inline void clear();
+  inline szt size() const;
+  inline bool empty() const;
+
+private:
+  void Encode(szt Value);
+  szt Decode(szt& Pos) const;
+  szt Seek(cszt Index) const;
+
+
+private:
+  vector<uchar> Data;
+  // where every CHANGELIST_BLOCK-th change starts in the data
+  vector<uint> Blocks;
+  szt Count = 0;
+};
+
+void ChangeList::clear()
+{
+  Data.clear();
+  Blocks.clear();
+  Count = 0;
+}
+
+szt ChangeList::size() const
+{
+  return Count;
+}
+
+bool ChangeList::empty() const
+{
+  return !Count;
+}
+
+#endif // CHANGELIST_H
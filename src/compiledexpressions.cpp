@@ -0,0 +1,432 @@
+#include "compiledexpressions.h"
+
+const map<const string, cszt> FunctionNameMap = {
+  { "Size", bookFunctionSize },
+  { "Play", bookFunctionPlay },
+  { "Stop", bookFunctionStop },
+  { "Keyword", bookFunctionKeyword },
+  { "SelectValue", bookFunctionSelectValue },
+  { "Print", bookFunctionPrint },
+  { "CloseMenu", bookFunctionCloseMenu },
+  { "OpenMenu", bookFunctionOpenMenu },
+  { "CloseBook", bookFunctionCloseBook },
+  { "OpenBook", bookFunctionOpenBook },
+  { "Quit", bookFunctionQuit },
+  { "GetBooks", bookFunctionGetBooks },
+  { "IsInGame", bookFunctionIsInGame },
+  { "GetSessions", bookFunctionGetSessions },
+  { "GetSessionName", bookFunctionGetSessionName },
+  { "SaveSession", bookFunctionSaveSession },
+  { "BranchSession", bookFunctionBranchSession },
+  { "LoadSession", bookFunctionLoadSession },
+  { "NewSession", bookFunctionNewSession },
+  { "Bookmark", bookFunctionBookmark },
+  { "UserBookmark", bookFunctionUserBookmark },
+  { "LoadSnapshot", bookFunctionLoadSnapshot },
+  { "GetSnapshots", bookFunctionGetSnapshots },
+  { "GetBookmarks", bookFunctionGetBookmarks },
+  { "GetSnapshotIndex", bookFunctionGetSnapshotIndex },
+  { "Dialog", bookFunctionDialog },
+  { "Input", bookFunctionInput }
+};
+
+/** @brief translate the function name into an enum
+  * \return BOOK_FUNCTION_MAX if there's no such function
+  */
+szt CompiledExpressions::FindFunction(const string& Name)
+{
+  const auto it = FunctionNameMap.find(Name);
+  if (it != FunctionNameMap.end()) {
+    return it->second;
+  }
+  return BOOK_FUNCTION_MAX;
+}
+
+/** @brief Split the condition or instruction into clauses and work out
+  * their operators the same way ExecuteExpression used to on every run
+  * \return index of the expression in Expressions
+  */
+szt CompiledExpressions::Add(const text_view& Text,
+                             bool Condition)
+{
+  CompiledExpression expression;
+  expression.Text = Text;
+  expression.Condition = Condition;
+  expression.FirstClause = Clauses.size();
+
+  szt length = Text.size();
+  szt pos = 0;
+  bool shortAnd = false;
+  bool shortOr = false;
+
+  // might contain a chain of expressions so loop through them
+  while (pos < length) {
+    ExpressionClause clause;
+    token::tokenName op = token::add;
+    cszt aPos = FindCharacter(Text, token::Start[token::logicalAnd], pos);
+    cszt oPos = FindCharacter(Text, token::Start[token::logicalOr], pos);
+    cszt endPos = min(length, min(aPos, oPos));
+
+    if (endPos < length) {
+      if (aPos < oPos) {
+        shortAnd = true;
+        shortOr = false;
+      } else {
+        shortAnd = false;
+        shortOr = true;
+      }
+    }
+
+    szt_pair opPos;
+    if (Condition) {
+      // check which condition it is, in order of precedence
+      const token::tokenName conditions[] = {
+        token::contains, token::notContains, token::notEquals,
+        token::equalsOrLess, token::equalsOrMore, token::equals,
+        token::isMore, token::isLess
+      };
+      op = token::condition; // [?value]
+      for (const token::tokenName condition : conditions) {
+        opPos = FindToken(Text, condition, pos, endPos);
+        if (opPos.X != string::npos) {
+          op = condition;
+          break;
+        }
+      }
+    } else {
+      // check which assignment operation it is
+      const token::tokenName assignments[] = {
+        token::add, token::remove, token::assign
+      };
+      op = token::instruction; // [!value]
+      for (const token::tokenName assignment : assignments) {
+        opPos = FindToken(Text, assignment, pos, endPos);
+        if (opPos.X != string::npos) {
+          op = assignment;
+          break;
+        }
+      }
+    }
+
+    clause.Operation = op;
+    if (op == token::condition || op == token::instruction) {
+      // bare conditions and instructions evaluate the whole clause
+      clause.Left = AddValue(text_view(Text.Data + min(pos, length),
+                                       pos < endPos ? endPos - pos : 0));
+    } else {
+      const text_view left(Text.Data + pos,
+                           pos < opPos.X ? opPos.X - pos : 0);
+      const text_view right(Text.Data + min(opPos.Y + 1, length),
+                            opPos.Y + 1 < endPos ? endPos - opPos.Y - 1 : 0);
+      clause.LeftEmpty = left.empty();
+      clause.RightEmpty = right.empty();
+      if (!clause.LeftEmpty) {
+        clause.Left = AddValue(left);
+#ifdef DEVBUILD
+        const string& leftText = left.str();
+        clause.WarnLeft = Condition
+                          && FindTokenStart(leftText, token::number) == string::npos
+                          && FindTokenStart(leftText, token::value) == string::npos
+                          && FindTokenStart(leftText, token::function) == string::npos;
+#endif
+      }
+      clause.Right = AddValue(right);
+    }
+
+    clause.ShortAnd = shortAnd;
+    clause.ShortOr = shortOr;
+    Clauses.push_back(clause);
+
+    pos = endPos;
+    ++pos;
+  }
+
+  expression.ClauseCount = Clauses.size() - expression.FirstClause;
+  Expressions.push_back(expression);
+  return Expressions.size() - 1;
+}
+
+/** @brief Break up the value into operation nodes the same way
+  * EvaluateExpression used to, (arguments) are compiled as separate values
+  * \return index of the value in Values
+  */
+uint CompiledExpressions::AddValue(const text_view& Text)
+{
+  ExpressionValue value;
+  value.Text = Text;
+  szt length = Text.size();
+  szt pos = 0;
+  szt valuePos = 0;
+  szt valueEnd = 0; // needed because function names vary in length
+  vector<ExpressionNode> opStack;
+  vector<vector<text_view>> literals;
+  // nodes with (arguments) and where the arguments start and end
+  vector<szt_pair> argumentNodes;
+  vector<szt_pair> argumentPos;
+
+  // parse expressions like a+@b-func(arg)-#1
+  // into an array of pairs like this
+  // +,a  +,_ <- @,b  -,func_ <- (,arg  -,_ <- #,1
+  // _ <- means that the next pair will write its result there
+  // in case of functions it will replace the values that are the func names
+  while (pos < length) {
+    const char c = Text[pos];
+    bool valueFound = false;
+    bool opFound = false;
+    bool funcFound = false;
+
+    if (c == '\\') {
+      // ignore escaped characters
+      ++pos;
+    } else if (pos + 1 >= length) {
+      valueFound = true;
+      valueEnd = ++pos;
+      // at least one op needed to store the value
+      if (opStack.empty()) {
+        opStack.resize(1);
+        literals.resize(1);
+      }
+    } else {
+      // look for operators that delimate values
+      for (szt i = 0; i < token::OPERATION_NAME_MAX; ++i) {
+        if (token::Operations[i] == c) {
+          opFound = true;
+          valueEnd = pos;
+          valueFound = true;
+          if (pos > 0) {
+            // unless the expression starts with an operator we need
+            // a previous op to store the value in
+            if (opStack.empty()) {
+              opStack.resize(1);
+              literals.resize(1);
+            }
+          }
+          opStack.resize(opStack.size() + 1);
+          literals.resize(opStack.size());
+
+          // grouping and function calls recurse with the (contents)
+          if (i == token::parens) {
+            cszt funcEnd = FindTokenEnd(Text, token::function, pos);
+            if (funcEnd == string::npos) {
+              // the evaluation stops here after the earlier arguments
+              value.Unmatched = true;
+              pos = length;
+              break;
+            } else {
+              funcFound = true;
+              opStack.back().Nested = false; // the arguments are the value
+              argumentNodes.push_back(szt_pair(opStack.size() - 1, 0));
+              argumentPos.push_back(szt_pair(pos + 1, funcEnd));
+            }
+            pos = funcEnd;
+          }
+
+          opStack.back().Operation = (token::operationName)i;
+          break;
+        }
+      }
+      if (value.Unmatched) {
+        break;
+      }
+    }
+
+    if (valueFound && valueEnd > valuePos) {
+      // if an op was found this iteration, assign value to the previous op
+      cszt last = opFound ? opStack.size() - 2 : opStack.size() - 1;
+      // a value terminates a series of nested operators
+      opStack[last].Nested = funcFound; // unless it was a function
+      literals[last].push_back(text_view(Text.Data + valuePos,
+                                         valueEnd - valuePos));
+    }
+
+    ++pos;
+
+    if (opFound) {
+      valuePos = pos;
+    }
+  }
+
+  value.FirstNode = Nodes.size();
+  value.NodeCount = opStack.size();
+  for (szt i = 0, fSz = opStack.size(); i < fSz; ++i) {
+    ExpressionNode& node = opStack[i];
+    node.FirstLiteral = Literals.size();
+    node.LiteralCount = literals[i].size();
+    Literals.insert(Literals.end(), literals[i].begin(), literals[i].end());
+    Nodes.push_back(node);
+  }
+  const uint valueIndex = Values.size();
+  Values.push_back(value);
+
+  // arguments get their own nodes after this value's nodes
+  for (szt i = 0, fSz = argumentNodes.size(); i < fSz; ++i) {
+    const szt_pair& argPos = argumentPos[i];
+    const text_view args(Text.Data + argPos.X,
+                         argPos.X < argPos.Y ? argPos.Y - argPos.X : 0);
+    const uint argIndex = AddValue(args);
+    Nodes[value.FirstNode + argumentNodes[i].X].Arguments = argIndex + 1;
+  }
+
+  for (szt i = 0; i < value.NodeCount; ++i) {
+    PrepareNode(Nodes[value.FirstNode + i],
+                i ? &Nodes[value.FirstNode + i - 1] : NULL);
+  }
+
+  return valueIndex;
+}
+
+/** @brief Work out the parts of the node that don't depend on the session
+  */
+void CompiledExpressions::PrepareNode(ExpressionNode& Node,
+                                      const ExpressionNode* Previous)
+{
+  // operand of a node that isn't nested only ever holds its own literals
+  // unless it's a function call with arguments
+  if (Node.Operation == token::integer && !Node.Nested && !Node.Arguments) {
+    vector<text_view> nouns;
+    lint number = 0;
+    for (szt i = 0; i < Node.LiteralCount; ++i) {
+      const text_view& literal = Literals[Node.FirstLiteral + i];
+      bool duplicate = false;
+      for (szt j = 0; j < i; ++j) {
+        duplicate |= (Literals[Node.FirstLiteral + j] == literal);
+      }
+      if (duplicate || literal.empty()) {
+        continue;
+      }
+      if (isdigit(literal[0]) || literal[0] == '-') {
+        // only plain numbers are safe to read in advance
+        bool plain = literal[0] != '-' || literal.size() > 1;
+        for (szt j = 1; j < literal.size(); ++j) {
+          plain &= (bool)isdigit(literal[j]);
+        }
+        if (!plain || literal.size() > 9) {
+          return;
+        }
+        number += IntoInt(literal);
+      } else {
+        nouns.push_back(literal);
+      }
+    }
+    // only the noun names are left to be looked up when it runs
+    Node.Numeric = true;
+    Node.Number = number;
+    Node.LiteralCount = nouns.size();
+    for (szt i = 0, fSz = nouns.size(); i < fSz; ++i) {
+      Literals[Node.FirstLiteral + i] = nouns[i];
+    }
+  }
+
+  // the node before ( holds the function names, if they're only literals
+  // we can find the functions now
+  if (Node.Operation == token::parens && Previous
+      && Previous->Operation != token::parens && Previous->Nested
+      && !Previous->Arguments) {
+    Node.KnownFunctions = true;
+    Node.FirstFunction = Functions.size();
+    vector<text_view> seen;
+    for (szt i = 0; i < Previous->LiteralCount; ++i) {
+      const text_view& literal = Literals[Previous->FirstLiteral + i];
+      bool duplicate = false;
+      for (const text_view& other : seen) {
+        duplicate |= (other == literal);
+      }
+      if (!duplicate && !literal.empty()) {
+        seen.push_back(literal);
+        Functions.push_back(FindFunction(literal.str()));
+      }
+    }
+  }
+}
+
+/** @brief Collect the nouns the expression reads the values of, anything that
+  * can't be known before it runs is flagged instead
+  */
+void CompiledExpressions::FindReads(szt Index,
+                                    ExpressionReads& Reads) const
+{
+  const CompiledExpression& expression = Expressions[Index];
+  for (szt i = 0; i < expression.ClauseCount; ++i) {
+    const ExpressionClause& clause = Clauses[expression.FirstClause + i];
+    if (!expression.Condition) {
+      // instructions write values
+      Reads.Volatile = true;
+      return;
+    }
+    if (clause.Operation == token::condition) {
+      // the values of a bare condition can be noun:verb or noun=value
+      // which run when the condition is checked
+      const ExpressionValue& value = Values[clause.Left];
+      if (FindCharacter(value.Text, ':') != string::npos
+          || FindCharacter(value.Text, '=') != string::npos) {
+        Reads.Volatile = true;
+        return;
+      }
+      const szt nouns = Reads.Nouns.size();
+      const bool dynamic = Reads.Dynamic;
+      FindValueReads(clause.Left, Reads);
+      // values read from nouns could hold them too so check when it runs
+      Reads.Dynamic = dynamic || Reads.Nouns.size() > nouns;
+      continue;
+    }
+    if (clause.LeftEmpty) {
+      Reads.Self = true;
+    } else {
+      FindValueReads(clause.Left, Reads);
+    }
+    FindValueReads(clause.Right, Reads);
+  }
+}
+
+/** @brief Add the nouns read by @ and # nodes of the value
+  */
+void CompiledExpressions::FindValueReads(uint Value,
+                                         ExpressionReads& Reads) const
+{
+  const ExpressionValue& value = Values[Value];
+  for (szt i = 0; i < value.NodeCount; ++i) {
+    const ExpressionNode& node = Nodes[value.FirstNode + i];
+    if (node.Arguments) {
+      FindValueReads(node.Arguments - 1, Reads);
+    }
+    bool nouns = false;
+    switch (node.Operation) {
+      case token::parens:
+        Reads.Volatile = true;
+        break;
+      case token::evaluate:
+      case token::integer:
+        // nested nodes get the names from the result of the next node
+        Reads.Dynamic |= node.Nested;
+        nouns = true;
+        break;
+      default:
+        break;
+    }
+    for (szt j = 0; nouns && j < node.LiteralCount; ++j) {
+      const text_view& literal = Literals[node.FirstLiteral + j];
+      // numbers read by # aren't nouns
+      if (literal.empty() || (node.Operation == token::integer
+                              && (isdigit(literal[0]) || literal[0] == '-'))) {
+        continue;
+      }
+      bool duplicate = false;
+      for (const text_view& noun : Reads.Nouns) {
+        duplicate |= (noun == literal);
+      }
+      if (!duplicate) {
+        Reads.Nouns.push_back(literal);
+      }
+    }
+  }
+}
+
+void CompiledExpressions::Clear()
+{
+  Expressions.clear();
+  Clauses.clear();
+  Values.clear();
+  Nodes.clear();
+  Literals.clear();
+  Functions.clear();
+}
@@ -0,0 +1,104 @@
+#ifndef COMPILEDEXPRESSIONS_H
+#define COMPILEDEXPRESSIONS_H
+
+#include "main.h"
+#include "tokens.h"
+
+const uint NO_EXPRESSION = (uint)-1;
+
+/** @brief One operation of an evaluated value like +@noun or #1
+  *
+  * These are the operation nodes EvaluateExpression used to build from
+  * the text every time it ran.
+  */
+struct ExpressionNode {
+  token::operationName Operation = token::plus;
+  bool Nested = true; // nested doesn't have operand, copy from result of next
+  // literal values written in the expression kept in Literals
+  uint FirstLiteral = 0;
+  uint LiteralCount = 0;
+  uint Arguments = 0; // index + 1 of the value with the (arguments)
+  // #1 with only plain numbers and noun names is added up in advance,
+  // only the noun names are left in the literals
+  bool Numeric = false;
+  lint Number = 0;
+  // function names before ( are looked up in advance, kept in Functions
+  bool KnownFunctions = false;
+  uint FirstFunction = 0;
+};
+
+/** @brief A value like a+@b-func(arg)-#1 turned into its operation nodes
+  */
+struct ExpressionValue {
+  text_view Text;
+  uint FirstNode = 0;
+  uint NodeCount = 0;
+  bool Unmatched = false; // missing ) ends the value early
+};
+
+/** @brief One of the & | chained parts of a condition or instruction
+  */
+struct ExpressionClause {
+  token::tokenName Operation = token::add;
+  uint Left = 0;
+  uint Right = 0;
+  bool LeftEmpty = true;
+  bool RightEmpty = true;
+  bool ShortAnd = false;
+  bool ShortOr = false;
+  bool WarnLeft = false; // left side is a bare noun name
+};
+
+/** @brief A whole condition or instruction
+  */
+struct CompiledExpression {
+  text_view Text;
+  uint FirstClause = 0;
+  uint ClauseCount = 0;
+  bool Condition = false;
+};
+
+/** @brief Nouns whose values a condition reads, worked out from the nodes
+  * without running it
+  */
+struct ExpressionReads {
+  vector<text_view> Nouns; // named in the expression like @noun or #noun
+  bool Self = false; // compares the values of the noun the verb belongs to
+  bool Dynamic = false; // names of the nouns come from values like @@noun
+  bool Volatile = false; // calls functions or runs noun:verb and assignments
+};
+
+/** @brief Conditions and instructions parsed once into typed nodes
+  * so they can be run without scanning the text again
+  *
+  * All the expressions of a verb share the same arrays, the views point into
+  * the text of the expressions so it has to outlive them.
+  */
+class CompiledExpressions
+{
+public:
+  CompiledExpressions() { };
+  ~CompiledExpressions() { };
+
+  szt Add(const text_view& Text, bool Condition);
+  void Clear();
+  void FindReads(szt Index, ExpressionReads& Reads) const;
+
+  static szt FindFunction(const string& Name);
+
+private:
+  uint AddValue(const text_view& Text);
+  void PrepareNode(ExpressionNode& Node, const ExpressionNode* Previous);
+  void FindValueReads(uint Value, ExpressionReads& Reads) const;
+
+
+public:
+  vector<CompiledExpression> Expressions;
+  vector<ExpressionClause> Clauses;
+  vector<ExpressionValue> Values;
+  vector<ExpressionNode> Nodes;
+  vector<text_view> Literals;
+  vector<szt> Functions;
+};
+
+#endif // COMPILEDEXPRESSIONS_H
@@ -1,6 +1,41 @@
 #include "disk.h"
 #include <sys/stat.h>
 #include <dirent.h>
+#include <cstdio>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// the file is written here first and moved over the old one when complete
+const string REPLACE_EXT = ".new";
+
+/** @brief Write the data and wait for it to reach the disk
+  */
+static bool WriteSynced(const string& Filename, const string& Data, const char* Mode)
+{
+  FILE* file = fopen(Filename.c_str(), Mode);
+  if (!file) {
+    LOG(Filename + " - can't write file");
+    return false;
+  }
+  bool written = fwrite(Data.data(), 1, Data.size(), file) == Data.size()
+                 && fflush(file) == 0;
+#ifdef _WIN32
+  written = written && _commit(_fileno(file)) == 0;
+#else
+  written = written && fsync(fileno(file)) == 0;
+#endif
+  written = fclose(file) == 0 && written;
+  if (!written) {
+    LOG(Filename + " - failed to write file");
+  }
+  return written;
+}
 
 /** @brief Return files of given extension without stripping the extension
   */
@@ -8,30 +43,58 @@ vector<string> Disk::ListFiles(const string& Path,
                                const string& Extension,
                                bool StripExtension)
 {
-  vector<string> files;
-  // get raw files
+  vector<DirectoryEntry> entries;
+  ReadDirectory(Path, entries);
+  return FilterFiles(entries, Extension, StripExtension);
+}
+
+/** @brief Return files that start with the stem (stem0, stem1, etc.)
+  */
+vector<string> Disk::GetFileSeries(const string& Path,
+                                   const string& Stem)
+{
+  vector<DirectoryEntry> entries;
+  ReadDirectory(Path, entries);
+  return FilterSeries(entries, Stem);
+}
+
+/** @brief Everything in the directory apart from . and ..
+  */
+bool Disk::ReadDirectory(const string& Path,
+                         vector<DirectoryEntry>& Entries)
+{
+  Entries.clear();
   DIR* directory = opendir(Path.c_str());
   if (directory == NULL) {
     LOG("Error " + IntoString(errno) + " trying to access: " + Path);
-    return files;
+    return false;
   }
   struct dirent* content;
   while ((content = readdir(directory)) != NULL) {
     string filename(content->d_name);
     if (filename != "." && filename != "..") {
-      files.push_back(filename);
+      Entries.push_back(DirectoryEntry());
+      Entries.back().Name.swap(filename);
+      Entries.back().Directory = DT_DIR == content->d_type;
     }
   }
+  closedir(directory);
+  return true;
+}
 
-  // filter files
-  if (Extension.empty()) {
-    closedir(directory);
-    return files;
-  }
+/** @brief Names of the entries with the extension, directories included
+  */
+vector<string> Disk::FilterFiles(const vector<DirectoryEntry>& Entries,
+                                 const string& Extension,
+                                 bool StripExtension)
+{
   vector<string> result;
-  for (const string& file : files) {
+  for (const DirectoryEntry& entry : Entries) {
+    const string& file = entry.Name;
     cszt length = file.size();
-    if (length > Extension.size()) {
+    if (Extension.empty()) {
+      result.push_back(file);
+    } else if (length > Extension.size()) {
       const string& ext = CutString(file, length - Extension.size());
       if (ext == Extension) {
         if (StripExtension) {
@@ -43,55 +106,35 @@ vector<string> Disk::ListFiles(const string& Path,
       }
     }
   }
-  closedir(directory);
   return result;
 }
 
-/** @brief Return files that start with the stem (stem0, stem1, etc.)
+/** @brief Files, not directories, named the stem followed by 0, 1, 2 and
+  * so on up to the first number missing
   */
-vector<string> Disk::GetFileSeries(const string& Path,
-                                   const string& Stem)
+vector<string> Disk::FilterSeries(const vector<DirectoryEntry>& Entries,
+                                  const string& Stem)
 {
   vector<string> files;
-  // get raw files
-  DIR* directory = opendir(Path.c_str());
-  if (directory == NULL) {
-    LOG("Error " + IntoString(errno) + " trying to access: " + Path);
-    return files;
-  }
-  struct dirent* content;
-  while ((content = readdir(directory)) != NULL) {
-    if (DT_DIR != content->d_type) { // ignore . and ..
-      string filename(content->d_name);
-      files.push_back(filename);
+  for (const DirectoryEntry& entry : Entries) {
+    if (!entry.Directory) {
+      files.push_back(entry.Name);
     }
   }
-
-  // filter files
   if (Stem.empty()) {
-    closedir(directory);
     return files;
   }
+  // names starting with the same text are next to each other when sorted
+  sort(files.begin(), files.end());
   vector<string> result;
-  szt series = 0;
-  bool found = true;
-  while (found) {
-    found = false;
-    const string suffix = IntoString(series);
-    const string match = Stem + suffix;
-    for (const string& file : files) {
-      if (file.size() > match.size()) {
-        const string& name = CutString(file, 0, match.size());
-        if (name == match) {
-          result.push_back(file);
-          found = true;
-          ++series;
-          break;
-        }
-      }
+  for (szt series = 0; ; ++series) {
+    const string match = Stem + IntoString(series);
+    auto it = upper_bound(files.begin(), files.end(), match);
+    if (it == files.end() || it->compare(0, match.size(), match) != 0) {
+      break;
     }
+    result.push_back(*it);
   }
-  closedir(directory);
   return result;
 }
 
@@ -110,6 +153,57 @@ bool Disk::Write(const string& Filename, const string& Text)
   }
 }
 
+/** @brief Add raw bytes to the end of the file, creating it if needed,
+  * returns once they're on the disk
+  */
+bool Disk::AppendBinary(const string& Filename, const string& Data)
+{
+  return WriteSynced(Filename, Data, "ab");
+}
+
+/** @brief Write the file next to the old one and move it over it once it's
+  * on the disk, so a crash leaves either the old or the new file whole
+  */
+bool Disk::Replace(const string& Filename, const string& Data)
+{
+  const string& tempFilename = Filename + REPLACE_EXT;
+  if (!WriteSynced(tempFilename, Data, "wb")
+      || !Rename(tempFilename, Filename)) {
+    return false;
+  }
+#ifndef _WIN32
+  // the rename is only kept once the directory is on the disk too
+  cszt slashPos = Filename.find_last_of(SLASH);
+  const string& path = slashPos == string::npos ? string(".")
+                       : Filename.substr(0, slashPos);
+  const int directory = open(path.c_str(), O_RDONLY);
+  if (directory != -1) {
+    fsync(directory);
+    close(directory);
+  }
+#endif
+  return true;
+}
+
+/** @brief Move the file over another one, replacing it
+  */
+bool Disk::Rename(const string& Filename, const string& NewFilename)
+{
+#ifdef _WIN32
+  // rename won't replace an existing file here
+  const bool renamed = MoveFileExA(Filename.c_str(), NewFilename.c_str(),
+                                   MOVEFILE_REPLACE_EXISTING
+                                   | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  const bool renamed = rename(Filename.c_str(), NewFilename.c_str()) == 0;
+#endif
+  if (!renamed) {
+    LOG(Filename + " - can't rename to " + NewFilename);
+    return false;
+  }
+  return true;
+}
+
 bool Disk::Delete(const string& Filename)
 {
   return (remove(Filename.c_str()) == 0);
@@ -120,3 +214,18 @@ bool Disk::Exists(const string& Filename)
   struct stat fileStat;
   return (stat(Filename.c_str(), &fileStat) != -1);
 }
+
+/** @brief Time of the last change and size of the file or directory
+  */
+bool Disk::GetFileInfo(const string& Filename,
+                       lint& Modified,
+                       szt& Size)
+{
+  struct stat fileStat;
+  if (stat(Filename.c_str(), &fileStat) == -1) {
+    return false;
+  }
+  Modified = fileStat.st_mtime;
+  Size = fileStat.st_size;
+  return true;
+}
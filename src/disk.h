@@ -4,6 +4,11 @@
 #include "main.h"
 #include "file.h"
 
+struct DirectoryEntry {
+  string Name;
+  bool Directory = false;
+};
+
 class Disk
 {
 public:
@@ -11,13 +16,24 @@ public:
   ~Disk() { };
 
   static bool Write(const string& Filename, const string& Text);
+  static bool AppendBinary(const string& Filename, const string& Data);
+  static bool Replace(const string& Filename, const string& Data);
+  static bool Rename(const string& Filename, const string& NewFilename);
   static bool Delete(const string& Filename);
   static bool Exists(const string& Filename);
+  static bool GetFileInfo(const string& Filename, lint& Modified, szt& Size);
   static vector<string> ListFiles(const string& Path,
                                   const string& Extension = "",
                                   bool StripExtension = false);
   static vector<string> GetFileSeries(const string& Path,
                                       const string& Stem = "");
+  static bool ReadDirectory(const string& Path,
+                            vector<DirectoryEntry>& Entries);
+  static vector<string> FilterFiles(const vector<DirectoryEntry>& Entries,
+                                    const string& Extension = "",
+                                    bool StripExtension = false);
+  static vector<string> FilterSeries(const vector<DirectoryEntry>& Entries,
+                                     const string& Stem = "");
 };
 
 #endif // DISK_H
@@ -1,4 +1,10 @@
 #include "file.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 File::~File()
 {
@@ -71,3 +77,69 @@ bool File::GetRawLine(string& Buffer)
     return !Buffer.empty();
   }
 }
+
+MappedFile::~MappedFile()
+{
+  Unmap();
+}
+
+#ifdef _WIN32
+/** @brief No mmap here so just read the whole file in
+  */
+bool MappedFile::Map(const string& Filename)
+{
+  Unmap();
+  ifstream stream(Filename.c_str(), std::ios::binary);
+  if (!stream.is_open()) {
+    return false;
+  }
+  Buffer.assign(std::istreambuf_iterator<char>(stream),
+                std::istreambuf_iterator<char>());
+  Data = Buffer.data();
+  Size = Buffer.size();
+  return true;
+}
+
+void MappedFile::Unmap()
+{
+  Buffer.clear();
+  Data = NULL;
+  Size = 0;
+}
+#else
+/** @brief Map the file read only, the pages only get read when touched
+  */
+bool MappedFile::Map(const string& Filename)
+{
+  Unmap();
+  const int handle = open(Filename.c_str(), O_RDONLY);
+  if (handle < 0) {
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(handle, &fileStat) < 0 || fileStat.st_size <= 0) {
+    close(handle);
+    return false;
+  }
+  void* mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE,
+                       handle, 0);
+  // the mapping keeps the file alive on its own
+  close(handle);
+  if (mapping == MAP_FAILED) {
+    LOG(Filename + " - can't map file");
+    return false;
+  }
+  Data = static_cast<const char*>(mapping);
+  Size = fileStat.st_size;
+  return true;
+}
+
+void MappedFile::Unmap()
+{
+  if (Data) {
+    munmap(const_cast<char*>(Data), Size);
+    Data = NULL;
+    Size = 0;
+  }
+}
+#endif
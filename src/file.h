@@ -20,4 +20,29 @@ private:
   ifstream Stream;
 };
 
+/** @brief Read only view of a whole file mapped into memory
+  */
+class MappedFile
+{
+public:
+  MappedFile() { };
+  ~MappedFile();
+
+  bool Map(const string& Filename);
+  void Unmap();
+
+
+public:
+  const char* Data = NULL;
+  szt Size = 0;
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+  string Buffer;
+#endif
+};
+
 #endif // FILE_H
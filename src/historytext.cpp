@@ -0,0 +1,46 @@
+#include "historytext.h"
+
+/** @brief Texts can be loaded from this data from now on, it can only be
+  * added before any texts are copied in as their references would change
+  */
+void HistoryText::AddSegment(const char* aData, cszt aSize)
+{
+  Segment segment;
+  segment.Data = aData;
+  segment.Size = aSize;
+  segment.Reference = MappedSize;
+  Segments.push_back(segment);
+  MappedSize += aSize;
+}
+
+/** @brief Copy the text in
+  * \return reference to it
+  */
+uint HistoryText::Add(const text_view& Text)
+{
+  const uint reference = MappedSize + Data.size();
+  PutString(Data, Text);
+  return reference;
+}
+
+/** @brief The text has to be one read from a mapped segment, preceded by
+  * its length like every string in the journal
+  * \return reference to where it is
+  */
+uint HistoryText::AddMapped(const text_view& Text) const
+{
+  const char* text = Text.Data - 4;
+  szt i = Segments.size() - 1;
+  while (i && (text < Segments[i].Data
+               || text >= Segments[i].Data + Segments[i].Size)) {
+    --i;
+  }
+  return Segments[i].Reference + (text - Segments[i].Data);
+}
+
+void HistoryText::Clear()
+{
+  Segments.clear();
+  MappedSize = 0;
+  Data.clear();
+}
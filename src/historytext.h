@@ -0,0 +1,59 @@
+#ifndef HISTORYTEXT_H
+#define HISTORYTEXT_H
+
+#include "main.h"
+#include "binarydata.h"
+
+/** @brief Texts of the session histories, which keep four byte references
+  * to them instead of the texts themselves
+  *
+  * Texts are kept the way the session journal writes them, the length
+  * followed by the text, so the ones loaded from it are referenced where
+  * they are in the mapped file and are only read when needed. The ones
+  * recorded since are appended to Data. A branched session maps the files
+  * it shares its history with too, each one is a segment referenced after
+  * the ones mapped before it and Data comes after all of them.
+  */
+class HistoryText
+{
+public:
+  HistoryText() { };
+  ~HistoryText() { };
+
+  void AddSegment(const char* aData, cszt aSize);
+  uint Add(const text_view& Text);
+  uint AddMapped(const text_view& Text) const;
+  inline text_view Get(const uint Reference) const;
+  void Clear();
+
+private:
+  struct Segment {
+    const char* Data;
+    szt Size;
+    szt Reference; // of its first byte
+  };
+
+  vector<Segment> Segments;
+  szt MappedSize = 0;
+  string Data;
+};
+
+/** @brief The text is only valid until the next text is added
+  */
+text_view HistoryText::Get(const uint Reference) const
+{
+  const char* text;
+  if (Reference < MappedSize) {
+    szt i = Segments.size() - 1;
+    while (Segments[i].Reference > Reference) {
+      --i;
+    }
+    text = Segments[i].Data + (Reference - Segments[i].Reference);
+  } else {
+    text = Data.data() + (Reference - MappedSize);
+  }
+  BinaryReader length(text, 4);
+  return text_view(text + 4, length.U32());
+}
+
+#endif // HISTORYTEXT_H
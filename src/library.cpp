@@ -0,0 +1,191 @@
+#include "library.h"
+#include "file.h"
+#include "binarydata.h"
+#include "writequeue.h"
+#include <ctime>
+
+const char LIBRARY_MAGIC[] = "LETHELB";
+const uint32_t LIBRARY_VERSION = 1;
+// seconds a file or directory has to stay untouched before what was read
+// from it is trusted to still be the same while its time is
+const lint LIBRARY_SETTLE = 2;
+
+map<string, LibraryDirectory> Library::Directories;
+map<string, LibraryHash> Library::Hashes;
+bool Library::Loaded = false;
+bool Library::Changed = false;
+
+/** @brief Was it read long enough after it was modified
+  */
+inline bool IsSettled(const lint Modified, const lint Read)
+{
+  return Modified + LIBRARY_SETTLE < Read;
+}
+
+/** @brief Queue the library file to be written if anything changed
+  */
+void Library::Save(WriteQueue& Writer)
+{
+  if (!Changed) {
+    return;
+  }
+  Changed = false;
+  string data;
+  data.append(LIBRARY_MAGIC, 8);
+  PutU32(data, LIBRARY_VERSION);
+  PutU32(data, Directories.size());
+  for (const auto& directory : Directories) {
+    PutString(data, directory.first);
+    PutU64(data, directory.second.Modified);
+    PutU64(data, directory.second.Listed);
+    PutU32(data, directory.second.Entries.size());
+    for (const DirectoryEntry& entry : directory.second.Entries) {
+      PutString(data, entry.Name);
+      data += (char)entry.Directory;
+    }
+  }
+  PutU32(data, Hashes.size());
+  for (const auto& hash : Hashes) {
+    PutString(data, hash.first);
+    PutU64(data, hash.second.Modified);
+    PutU64(data, hash.second.Size);
+    PutU64(data, hash.second.Hashed);
+    PutU64(data, hash.second.Hash);
+  }
+  Writer.Replace(LIBRARY_FILE, data);
+}
+
+/** @brief Files in the directory, listed again only if it changed
+  */
+vector<string> Library::ListFiles(const string& Path,
+                                  const string& Extension,
+                                  bool StripExtension)
+{
+  return Disk::FilterFiles(GetEntries(Path), Extension, StripExtension);
+}
+
+/** @brief Return files that start with the stem (stem0, stem1, etc.)
+  */
+vector<string> Library::GetFileSeries(const string& Path,
+                                      const string& Stem)
+{
+  return Disk::FilterSeries(GetEntries(Path), Stem);
+}
+
+/** @brief Hash of the contents of the file, only read again if its size
+  * or time changed
+  * \return 0 if it can't be read
+  */
+uint64_t Library::HashFile(const string& Filename)
+{
+  Load();
+  lint modified;
+  szt size;
+  if (!Disk::GetFileInfo(Filename, modified, size)) {
+    return 0;
+  }
+  const auto it = Hashes.find(Filename);
+  if (it != Hashes.end() && it->second.Modified == modified
+      && it->second.Size == size
+      && IsSettled(it->second.Modified, it->second.Hashed)) {
+    return it->second.Hash;
+  }
+
+  LibraryHash& hash = Hashes[Filename];
+  hash.Modified = modified;
+  hash.Size = size;
+  hash.Hashed = time(NULL);
+  hash.Hash = 0;
+  MappedFile source;
+  if (source.Map(Filename)) {
+    hash.Hash = FNV_OFFSET;
+    HashBytes(hash.Hash, source.Data, source.Size);
+  }
+  Changed = true;
+  return hash.Hash;
+}
+
+/** @brief Read the library file the first time it's needed, a damaged one
+  * is dropped and everything gets read from the disk again
+  */
+void Library::Load()
+{
+  if (Loaded) {
+    return;
+  }
+  Loaded = true;
+  MappedFile file;
+  if (!file.Map(LIBRARY_FILE) || file.Size < 12
+      || string(file.Data, 7) != LIBRARY_MAGIC) {
+    return;
+  }
+  BinaryReader reader(file.Data, file.Size, 8);
+  if (reader.U32() != LIBRARY_VERSION) {
+    return;
+  }
+  // every entry takes at least a byte so counts beyond that are damage
+  szt count = reader.U32();
+  if (count > reader.Size - reader.Pos) {
+    reader.Failed = true;
+  }
+  for (szt i = 0; i < count && !reader.Failed; ++i) {
+    string path;
+    reader.Str(path);
+    LibraryDirectory& directory = Directories[path];
+    directory.Modified = reader.U64();
+    directory.Listed = reader.U64();
+    cszt entryCount = reader.U32();
+    if (reader.Failed || entryCount > reader.Size - reader.Pos) {
+      reader.Failed = true;
+      break;
+    }
+    directory.Entries.resize(entryCount);
+    for (DirectoryEntry& entry : directory.Entries) {
+      reader.Str(entry.Name);
+      entry.Directory = reader.U8();
+    }
+  }
+  count = reader.U32();
+  if (count > reader.Size - reader.Pos) {
+    reader.Failed = true;
+  }
+  for (szt i = 0; i < count && !reader.Failed; ++i) {
+    string filename;
+    reader.Str(filename);
+    LibraryHash& hash = Hashes[filename];
+    hash.Modified = reader.U64();
+    hash.Size = reader.U64();
+    hash.Hashed = reader.U64();
+    hash.Hash = reader.U64();
+  }
+  if (reader.Failed || reader.Pos != reader.Size) {
+    LOG(LIBRARY_FILE + " - damaged library file, reading the disk again");
+    Directories.clear();
+    Hashes.clear();
+  }
+}
+
+/** @brief The listing of the directory, kept if it hasn't been modified
+  * since it was read
+  */
+const vector<DirectoryEntry>& Library::GetEntries(const string& Path)
+{
+  Load();
+  lint modified;
+  szt size;
+  if (!Disk::GetFileInfo(Path, modified, size)) {
+    modified = 0;
+  }
+  const auto it = Directories.find(Path);
+  if (it != Directories.end() && modified && it->second.Modified == modified
+      && IsSettled(it->second.Modified, it->second.Listed)) {
+    return it->second.Entries;
+  }
+
+  LibraryDirectory& directory = Directories[Path];
+  directory.Modified = modified;
+  directory.Listed = time(NULL);
+  Disk::ReadDirectory(Path, directory.Entries);
+  Changed = true;
+  return directory.Entries;
+}
@@ -0,0 +1,59 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "main.h"
+#include "disk.h"
+#include <stdint.h>
+
+class WriteQueue;
+
+struct LibraryDirectory {
+  lint Modified = 0;
+  lint Listed = 0;
+  vector<DirectoryEntry> Entries;
+};
+
+struct LibraryHash {
+  lint Modified = 0;
+  szt Size = 0;
+  lint Hashed = 0;
+  uint64_t Hash = 0;
+};
+
+/** @brief Directory listings and hashes of the story files kept between
+  * runs so the menus and opening books don't walk the disk every time
+  *
+  * A listing is used as long as the directory hasn't been modified since,
+  * a hash as long as the file has the same size and time. Times only have
+  * a resolution of a second or two so anything read too soon after it was
+  * modified is read again the next time. It's all in a file in the data
+  * directory that's written whenever something in it changed. Only used
+  * from the main thread.
+  */
+class Library
+{
+public:
+  Library() { };
+  ~Library() { };
+
+  static void Save(WriteQueue& Writer);
+  static vector<string> ListFiles(const string& Path,
+                                  const string& Extension = "",
+                                  bool StripExtension = false);
+  static vector<string> GetFileSeries(const string& Path,
+                                      const string& Stem = "");
+  static uint64_t HashFile(const string& Filename);
+
+private:
+  static void Load();
+  static const vector<DirectoryEntry>& GetEntries(const string& Path);
+
+
+private:
+  static map<string, LibraryDirectory> Directories;
+  static map<string, LibraryHash> Hashes;
+  static bool Loaded;
+  static bool Changed;
+};
+
+#endif // LIBRARY_H
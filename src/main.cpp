@@ -36,6 +36,7 @@ extern "C" void Java_org_libsdl_app_SDLActivity_nativeInit(JNIEnv* env,
 string GLog = "";
 string GTrace = "";
 szt GTraceIndent = 0;
+std::mutex GLogMutex;
 #endif
 
 int main(int Count, char* Switches[])
@@ -56,6 +57,13 @@ int main(int Count, char* Switches[])
     if (argument == "-s" || argument == "-silent" || argument == "-no-sound") {
       sound = false;
     }
+#ifdef DEVBUILD
+    // play the book without the reader in ways that have to show the same
+    if (argument == "-check") {
+      return Book::CheckBook(i + 1 < Count ? Switches[i + 1] : "tutorial") ?
+             0 : 1;
+    }
+#endif
   }
 
   Reader reader(width, height, 32, sound);
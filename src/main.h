@@ -6,6 +6,8 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cstring>
+#include <cctype>
 #include <iterator>
 #include <vector>
 #include <map>
@@ -37,11 +39,15 @@ typedef const size_t cszt;
 typedef size_t szt;
 
 #ifdef DEVBUILD
+#include <mutex>
 extern string GLog;
 extern string GTrace;
 extern szt GTraceIndent;
+// stories are parsed on many threads at once
+extern std::mutex GLogMutex;
 #define LOG(t) { string log = (t); \
-  if (log.size() > 0) { GLog = GLog + "\n" + log; cout << log << endl; } };
+  if (log.size() > 0) { std::lock_guard<std::mutex> logLock(GLogMutex); \
+    GLog = GLog + "\n" + log; cout << log << endl; } };
 #else
 #define LOG(t);
 #endif
@@ -60,10 +66,14 @@ const string FRAMES_DIR = DATA_DIR + SLASH + "frames";
 const string BUTTONS_DIR = DATA_DIR + SLASH + "buttons";
 const string SESSION_EXT = ".session";
 const string STORY_EXT = ".story";
+const string STORY_CACHE_EXT = ".storyc";
 const string STORY_FILE = "story";
 const string SESSION_MAP = "session";
 const string SETTINGS_FILE = DATA_DIR + SLASH + "settings";
+const string LIBRARY_FILE = DATA_DIR + SLASH + "library";
 const char BACKSPACE_CHAR = (char)8;
+// parse the rest of the story in the background after it's opened
+const bool STORY_WARM_UP = true;
 
 struct Colour {
   Colour() { };
@@ -97,6 +107,44 @@ struct string_pair {
   string Y;
 };
 
+/** @brief Read only run of characters owned by someone else, the owner has
+  * to outlive the view
+  */
+struct text_view {
+  text_view() { };
+  text_view(const char* aData, szt aSize) : Data(aData), Size(aSize) { };
+  text_view(const char* Text) : Data(Text), Size(strlen(Text)) { };
+  text_view(const string& Text) : Data(Text.data()), Size(Text.size()) { };
+  szt size() const
+  {
+    return Size;
+  };
+  bool empty() const
+  {
+    return !Size;
+  };
+  const char& operator[](szt Pos) const
+  {
+    return Data[Pos];
+  };
+  string str() const
+  {
+    return string(Data, Size);
+  };
+  const char* Data = "";
+  szt Size = 0;
+};
+
+inline bool operator==(const text_view& A, const text_view& B)
+{
+  return A.Size == B.Size && !memcmp(A.Data, B.Data, A.Size);
+}
+
+inline bool operator!=(const text_view& A, const text_view& B)
+{
+  return !(A == B);
+}
+
 struct int_pair {
   int_pair() : X(0), Y(0) { };
   int_pair(int aX, int aY) : X(aX), Y(aY) { };
@@ -154,6 +202,30 @@ template <typename T> inline real IntoReal(const T& Thing)
   return result;
 }
 
+/** @brief Read the number at the start of the text the way stoi does
+  * but without throwing, text without digits reads as 0
+  */
+inline lint ReadInteger(const text_view& Text)
+{
+  cszt length = Text.size();
+  szt pos = 0;
+  while (pos < length && isspace((uchar)Text[pos])) {
+    ++pos;
+  }
+  bool negative = false;
+  if (pos < length && (Text[pos] == '-' || Text[pos] == '+')) {
+    negative = Text[pos] == '-';
+    ++pos;
+  }
+  // too many digits wrap around instead of overflowing
+  ulint number = 0;
+  while (pos < length && Text[pos] >= '0' && Text[pos] <= '9') {
+    number = number * 10 + (Text[pos] - '0');
+    ++pos;
+  }
+  return negative ? -(lint)number : (lint)number;
+}
+
 template <typename T> inline int IntoInt(const T& Thing)
 {
   stringstream stream;
@@ -165,7 +237,12 @@ template <typename T> inline int IntoInt(const T& Thing)
 
 template <> inline int IntoInt(const string& Thing)
 {
-  return std::stoi(Thing);
+  return (int)ReadInteger(Thing);
+}
+
+inline int IntoInt(const text_view& Thing)
+{
+  return (int)ReadInteger(Thing);
 }
 
 template <typename T> inline szt IntoSizeT(const T& Thing)
@@ -177,6 +254,16 @@ template <typename T> inline szt IntoSizeT(const T& Thing)
   return integer;
 }
 
+template <> inline szt IntoSizeT(const string& Thing)
+{
+  return (szt)ReadInteger(Thing);
+}
+
+inline szt IntoSizeT(const text_view& Thing)
+{
+  return (szt)ReadInteger(Thing);
+}
+
 inline string RealIntoString(const real a_real,
                              const usint a_precision = 3)
 {
@@ -186,11 +273,25 @@ inline string RealIntoString(const real a_real,
 }
 
 // cutString("01234", 2, 4) returns "23"
-inline string CutString(const string Text,
+inline string CutString(const text_view& Text,
                         cszt Start,
                         cszt End = string::npos)
 {
-  return Start < End ? Text.substr(Start, End - Start) : string();
+  if (Start < End && Start < Text.Size) {
+    return string(Text.Data + Start, min(End, Text.Size) - Start);
+  }
+  return string();
+}
+
+// same as CutString but the result points into the text
+inline text_view CutView(const text_view& Text,
+                         cszt Start,
+                         cszt End = string::npos)
+{
+  if (Start < End && Start < Text.Size) {
+    return text_view(Text.Data + Start, min(End, Text.Size) - Start);
+  }
+  return text_view();
 }
 
 template <typename T> inline void Clamp(T& Value,
@@ -1,30 +1,221 @@
 #include "page.h"
 #include "tokens.h"
 #include "pageparser.h"
+#include "textarena.h"
+#include <algorithm>
 
-VerbBlock Page::MissingVerb = { "", Block("You can't do that.", false), { } };
+VerbBlock Page::MissingVerb = { "", Block("You can't do that.", false), { }, { },
+                                CompiledExpressions(), NO_EXPRESSION,
+                                ExpressionReads(), { } };
+string Page::MissingVerbText;
 
-void Page::Parse(const string& SourceText)
+/** @brief Append the block and everything nested in it in depth first order
+  */
+static void FlattenBlock(const Block& MyBlock,
+                         vector<FlatBlock>& Blocks,
+                         cszt Parent,
+                         cszt Depth)
+{
+  cszt index = Blocks.size();
+  Blocks.push_back(FlatBlock());
+  FlatBlock& flat = Blocks.back();
+  flat.Expression = MyBlock.Expression;
+  flat.Parent = Parent;
+  flat.Depth = Depth;
+  flat.Execute = MyBlock.Execute;
+  flat.Else = MyBlock.Else;
+  const text_view& expression = MyBlock.Expression;
+  cszt length = expression.size();
+  if (MyBlock.Blocks.empty() && length && MyBlock.Execute
+      && FindTokenStart(expression, token::stop) != string::npos) {
+    // we know that at least two < exist already
+    szt breakUp = 3;
+    while (breakUp < length
+           && expression[breakUp] == token::Start[token::stop]) {
+      ++breakUp;
+    }
+    flat.BreakUp = breakUp;
+  }
+
+  for (const Block& child : MyBlock.Blocks) {
+    FlattenBlock(child, Blocks, index, Depth + 1);
+  }
+  Blocks[index].End = Blocks.size();
+}
+
+/** @brief Find or add the instruction that returns Value from the verb
+  */
+static uint CodeReturn(vector<VerbCode>& Code,
+                       cszt BlockCount,
+                       cszt Value)
+{
+  for (szt i = BlockCount, fSz = Code.size(); i < fSz; ++i) {
+    if (Code[i].Next == Value) {
+      return i;
+    }
+  }
+  Code.push_back(VerbCode());
+  Code.back().Operation = verbReturn;
+  Code.back().Next = Value;
+  return Code.size() - 1;
+}
+
+/** @brief Where to carry on once the block and its nested blocks are done,
+  * the else blocks right after it are skipped
+  */
+static uint CodeContinue(const vector<FlatBlock>& Blocks,
+                         vector<VerbCode>& Code,
+                         szt Index)
+{
+  while (Index) {
+    const FlatBlock& parent = Blocks[Blocks[Index].Parent];
+    szt next = Blocks[Index].End;
+    if (next < parent.End && Blocks[next].Else) {
+      next = Blocks[next].Skip;
+    }
+    if (next < parent.End) {
+      return next;
+    }
+    Index = Blocks[Index].Parent;
+  }
+  return CodeReturn(Code, Blocks.size(), 0);
+}
+
+/** @brief Where to carry on if the block fails, which is the next block
+  * if there is one as it's either an else or it doesn't care
+  */
+static uint CodeFail(const vector<FlatBlock>& Blocks,
+                     vector<VerbCode>& Code,
+                     szt Index)
+{
+  if (!Index) {
+    return CodeReturn(Code, Blocks.size(), 1);
+  }
+  const FlatBlock& parent = Blocks[Blocks[Index].Parent];
+  cszt next = Blocks[Index].End;
+  if (next < parent.End) {
+    return next;
+  }
+  return CodeContinue(Blocks, Code, Blocks[Index].Parent);
+}
+
+/** @brief Turn the parsed block tree into the flat array used for execution
+  */
+void VerbBlock::Flatten()
+{
+  Blocks.clear();
+  FlattenBlock(BlockTree, Blocks, 0, 0);
+  // a failed condition lets the else blocks that follow it run,
+  // otherwise the whole run of them gets skipped
+  for (szt i = Blocks.size(); i > 1; --i) {
+    FlatBlock& block = Blocks[i - 1];
+    if (block.Else) {
+      block.Skip = block.End;
+      if (block.Skip < Blocks[block.Parent].End && Blocks[block.Skip].Else) {
+        block.Skip = Blocks[block.Skip].Skip;
+      }
+    }
+  }
+  BlockTree.Blocks.clear();
+  Compile();
+}
+
+/** @brief Compile the conditions and instructions of the flattened blocks
+  */
+void VerbBlock::Compile()
+{
+  Compiled.Clear();
+  Condition = NO_EXPRESSION;
+  ConditionReads = ExpressionReads();
+  for (szt i = 0, fSz = Blocks.size(); i < fSz; ++i) {
+    FlatBlock& block = Blocks[i];
+    block.Compiled = NO_EXPRESSION;
+    if (block.Expression.empty()) {
+      continue;
+    }
+    if (block.End > i + 1) {
+      block.Compiled = Compiled.Add(block.Expression, true);
+    } else if (block.Execute && !block.BreakUp) {
+      block.Compiled = Compiled.Add(block.Expression, false);
+    }
+  }
+  // the verb condition is evaluated even if the verb has no nested blocks
+  if (!Blocks.empty() && !Blocks[0].Expression.empty()) {
+    Condition = Blocks[0].End > 1 ? Blocks[0].Compiled
+                : Compiled.Add(Blocks[0].Expression, true);
+    Compiled.FindReads(Condition, ConditionReads);
+  }
+
+  // work out the jumps between the blocks for the verb code
+  cszt count = Blocks.size();
+  Code.clear();
+  Code.resize(count);
+  for (szt i = 0; i < count; ++i) {
+    const FlatBlock& block = Blocks[i];
+    // copy out of the vector as the returns get added to it
+    VerbCode code;
+    if (block.End > i + 1) {
+      code.Operation = block.Expression.empty() ? verbBlock : verbCondition;
+      // the first nested block unless it's an else
+      szt next = i + 1;
+      if (Blocks[next].Else) {
+        next = Blocks[next].Skip;
+      }
+      code.Next = next < block.End ? next : CodeContinue(Blocks, Code, i);
+      code.Fail = CodeFail(Blocks, Code, i);
+    } else {
+      if (block.Expression.empty()) {
+        code.Operation = verbBlock;
+      } else if (!block.Execute) {
+        code.Operation = verbText;
+      } else if (block.BreakUp) {
+        code.Operation = verbBreak;
+      } else {
+        code.Operation = verbInstruction;
+      }
+      code.Next = CodeContinue(Blocks, Code, i);
+      if (block.BreakUp) {
+        // go up the parents of the !<< and fail the one it ends on
+        szt up = i;
+        szt breakUp = block.BreakUp;
+        while (up && breakUp > 1) {
+          --breakUp;
+          up = Blocks[up].Parent;
+        }
+        code.Fail = up ? CodeFail(Blocks, Code, up)
+                    : CodeReturn(Code, count, breakUp);
+      }
+    }
+    Code[i] = code;
+  }
+}
+
+void Page::Parse(const string& SourceText,
+                 TextArena& Arena)
 {
-  PageParser(SourceText, *this);
+  // the source carries on from where the last shared pattern ended
+  PageParser(SourceText, *this, Arena,
+             Patterns.empty() ? NULL : Patterns.back());
 }
 
 /** @brief Get the reference to the top Block node of the verb
   *
   * \return the block belonging to a verb by the name passed in
   */
-const VerbBlock& Page::GetVerb(const string& Verb) const
+const VerbBlock& Page::GetVerb(const text_view& Verb) const
 {
   for (szt i = 0, fSz = Verbs.size(); i < fSz; ++i) {
     for (szt j = 0, fSzj = Verbs[i].Names.size(); j < fSzj; ++j) {
-      const string& name = Verbs[i].Names[j];
+      const text_view& name = Verbs[i].Names[j];
       if (name == Verb) {
         return Verbs[i];
       }
     }
   }
-  LOG("Verb: " + Verb + " missing.")
-  MissingVerb.BlockTree.Expression = "You can't " + Verb + " that.";
+  LOG("Verb: " + Verb.str() + " missing.")
+  MissingVerbText = "You can't " + Verb.str() + " that.";
+  MissingVerb.BlockTree.Expression = MissingVerbText;
+  MissingVerb.Flatten();
   return MissingVerb;
 }
 
@@ -49,3 +240,176 @@ void Page::AddVerb(const VerbBlock& Verb)
   Verbs.push_back(Verb);
 }
 
+/** @brief The text the page would be parsed from with the patterns expanded
+  */
+string Page::GetSource() const
+{
+  string text;
+  for (const PagePattern* pattern : Patterns) {
+    text += pattern->Expand(Keyword);
+  }
+  return text + Source;
+}
+
+/** @brief Replace the pattern name with the keyword
+  */
+static void ReplaceName(string& Text,
+                        const string& Name,
+                        const string& Keyword)
+{
+  szt pos = 0;
+  while (pos < Text.size()) { // size changes along the way
+    szt patternPos = Text.find(Name, pos);
+    if (patternPos != string::npos) {
+      Text.replace(patternPos, Name.size(), Keyword);
+      pos = patternPos + Keyword.size();
+    } else {
+      break;
+    }
+  }
+}
+
+/** @brief The pattern text with its name replaced by the keyword, ready to be
+  * prepended to the noun definition
+  */
+string PagePattern::Expand(const string& Keyword) const
+{
+  string text = Text;
+  ReplaceName(text, Name, Keyword);
+  return text;
+}
+
+/** @brief Parse the pattern the first time it's needed and check if its
+  * verbs can be used for the keyword instead of expanding the text
+  *
+  * NextText is whatever follows the pattern in the page, the next pattern
+  * or the noun text if it's the Last one.
+  */
+bool PagePattern::CanApply(const string& Keyword,
+                           const string& NextText,
+                           bool Last,
+                           TextArena& Arena)
+{
+  if (!Parsed) {
+    Parsed = true;
+    PageParser(Text, *this, Arena);
+  }
+
+  // the name has to be replaced inside the parsed parts of the text only
+  // which is only certain if neither of them contains any syntax
+  const char* syntax = "\"?![]{}:\\&|";
+  if (!Shareable || Name.empty()
+      || Name.find_first_of(syntax) != string::npos
+      || Keyword.find_first_of(syntax) != string::npos) {
+    return false;
+  }
+
+  if (!NextText.empty()) {
+    // the text has to start with something that ends the last statement
+    // of the pattern, only a new verb clears everything the pattern left
+    const char next = NextText[0];
+    if (next != token::Start[token::noun] && (!Last
+        || (next != token::Start[token::textBlock]
+            && next != token::Start[token::condition]
+            && next != token::Start[token::instruction]
+            && next != token::End[token::block]))) {
+      return false;
+    }
+  } else if (!Last) {
+    return false;
+  }
+
+  return (Last || Closed)
+         && (!VerbExpected || PageParser::IsVerbNext(NextText));
+}
+
+/** @brief Carry the verb conditions still open at the end of the pattern
+  * over to the text that follows it, with the positions moved into that text
+  */
+void PagePattern::ApplyConditions(vector<VerbCondition>& Conditions,
+                                  const string& Keyword,
+                                  const string& NextText) const
+{
+  for (VerbCondition condition : OpenConditions) {
+    ReplaceName(condition.Expression, Name, Keyword);
+    if (condition.Depth) {
+      // find the } the same way FindTokenEnd would have across both texts
+      szt depth = condition.Depth;
+      condition.End = string::npos;
+      for (szt i = 0, fSz = NextText.size(); i < fSz; ++i) {
+        if (IsSpecial(NextText, i, token::Start[token::block])) {
+          ++depth;
+        } else if (IsSpecial(NextText, i, token::End[token::block])
+                   && --depth == 0) {
+          condition.End = i;
+          break;
+        }
+      }
+    } else if (condition.End == Text.size()) {
+      // implied scope until the next verb
+      condition.End = NextText.size();
+    } else {
+      // ended inside the pattern, before anything in the text
+      condition.End = 0;
+    }
+    Conditions.push_back(condition);
+  }
+}
+
+/** @brief Add the verbs of the pattern to the page with the name replaced
+  * by the keyword, the text is shared where the name doesn't appear
+  *
+  * The verb left open at the end is only added if this isn't the Last
+  * pattern, otherwise the parser of the noun text carries on with it.
+  */
+void PagePattern::Apply(Page& MyPage,
+                        const string& Keyword,
+                        bool Last,
+                        TextArena& Arena) const
+{
+  for (const VerbBlock& patternVerb : Verbs) {
+    VerbBlock verb = patternVerb;
+    ApplyVerb(verb, Keyword, Arena);
+    MyPage.AddVerb(verb);
+  }
+  if (!Last && !OpenVerb.Names.empty()) {
+    VerbBlock verb = OpenVerb;
+    ApplyVerb(verb, Keyword, Arena);
+    MyPage.AddVerb(verb);
+  }
+}
+
+void PagePattern::ApplyVerb(VerbBlock& Verb,
+                            const string& Keyword,
+                            TextArena& Arena) const
+{
+  Verb.VisualName = ApplyText(Verb.VisualName, Keyword, Arena);
+  for (text_view& name : Verb.Names) {
+    name = ApplyText(name, Keyword, Arena);
+  }
+  ApplyBlock(Verb.BlockTree, Keyword, Arena);
+}
+
+void PagePattern::ApplyBlock(Block& MyBlock,
+                             const string& Keyword,
+                             TextArena& Arena) const
+{
+  MyBlock.Expression = ApplyText(MyBlock.Expression, Keyword, Arena);
+  for (Block& block : MyBlock.Blocks) {
+    ApplyBlock(block, Keyword, Arena);
+  }
+}
+
+text_view PagePattern::ApplyText(const text_view& MyText,
+                                 const string& Keyword,
+                                 TextArena& Arena) const
+{
+  const char* end = MyText.Data + MyText.Size;
+  if (std::search(MyText.Data, end, Name.begin(), Name.end()) == end) {
+    return MyText;
+  }
+
+  string text = MyText.str();
+  ReplaceName(text, Name, Keyword);
+  return Arena.Add(text);
+}
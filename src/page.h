@@ -3,30 +3,88 @@
 
 #include "main.h"
 #include "properties.h"
+#include "compiledexpressions.h"
 
 class PageParser;
+class PagePattern;
+class TextArena;
 
+// expressions and names are views into the text arena of the story
 struct Block {
-  Block(const string& Text, bool Executable = true)
+  Block(const text_view& Text, bool Executable = true)
     : Expression(Text), Execute(Executable) { };
   Block() { };
   ~Block() { };
-  string Expression;
+  text_view Expression;
   vector<Block> Blocks;
-  bool Execute;
+  bool Execute = true;
+  bool Else = false;
+};
+
+/** @brief Block of a verb kept in a flat array in depth first order,
+  * the blocks nested inside follow it up to its End
+  */
+struct FlatBlock {
+  text_view Expression;
+  uint End = 0; // one past the last block nested in this one
+  uint Parent = 0;
+  uint Skip = 0; // where to carry on if this else isn't needed
+  uint BreakUp = 0; // how many blocks up this !<< breaks out of
+  uint Depth = 0;
+  uint Compiled = NO_EXPRESSION; // condition or instruction in the verb
+  bool Execute = false;
   bool Else = false;
 };
 
+enum verbOperation {
+  verbBlock, // empty block or a condition without one, only traced
+  verbText,
+  verbInstruction,
+  verbCondition,
+  verbBreak,
+  verbReturn
+};
+
+/** @brief Instruction of the verb code, there's one for every flat block
+  * at the same index followed by the returns, the jumps are all worked out
+  * when compiling so running it doesn't need to walk the blocks
+  */
+struct VerbCode {
+  verbOperation Operation = verbBlock;
+  uint Next = 0; // where to go after it's done or the value returned
+  uint Fail = 0; // where to go if the condition fails or it breaks out
+};
+
+struct VerbCondition {
+  string Expression;
+  szt End;
+  szt Depth = 0; // { still open at the end of a pattern
+};
+
 struct VerbBlock {
   void Reset()
   {
-    VisualName.clear();
+    VisualName = text_view();
     BlockTree.Blocks.clear();
     Names.clear();
+    Blocks.clear();
+    Compiled.Clear();
+    Condition = NO_EXPRESSION;
+    ConditionReads = ExpressionReads();
+    Code.clear();
   };
-  string VisualName;
+  void Flatten();
+  void Compile();
+  text_view VisualName;
+  // only used while parsing, flattened into Blocks once the page is parsed
   Block BlockTree;
-  vector<string> Names;
+  vector<text_view> Names;
+  vector<FlatBlock> Blocks;
+  // expressions of the blocks compiled once the page is parsed or loaded
+  CompiledExpressions Compiled;
+  uint Condition; // verb condition used to list the verbs
+  ExpressionReads ConditionReads; // nouns the verb condition depends on
+  vector<VerbCode> Code;
 };
 
 class Page
@@ -35,12 +93,17 @@ public:
   Page() { };
   ~Page() { };
 
-  void Parse(const string& SourceText);
-  const VerbBlock& GetVerb(const string& Verb) const;
+  void Parse(const string& SourceText, TextArena& Arena);
+  const VerbBlock& GetVerb(const text_view& Verb) const;
   void AddVerb(const VerbBlock& Verb);
   void SetValues(const string& Values);
   void AddValues(const string& Values);
   void RemoveValues(const string& Values);
+  bool IsParsed() const
+  {
+    return Source.empty() && Patterns.empty();
+  };
+  string GetSource() const;
 
 
 public:
@@ -49,10 +112,71 @@ public:
 
 private:
   // this is the normalised Text of the page
-  // TODO: don't duplicate strings, use indices to Text
   string Text;
+  // source waiting for the parser until the page is first needed
+  string Source;
+  // patterns come before the source, their name replaced by the Keyword
+  vector<PagePattern*> Patterns;
+  string Keyword;
 
   static VerbBlock MissingVerb;
+  static string MissingVerbText;
+
+  friend class PageParser;
+  friend class Story;
+  friend class StoryCache;
+};
+
+/** @brief A [[pattern]] parsed once for all the nouns that use it
+  *
+  * The verbs keep the pattern name where the keyword of the noun goes
+  * and get copied into each page with the name replaced, the parser carries on
+  * with the noun text from where the pattern left off. Patterns that
+  * don't parse the same on their own as they would in front of the noun text
+  * are expanded into the page source like before.
+  */
+class PagePattern
+{
+public:
+  PagePattern(const string& aName, const string& aText)
+    : Name(aName), Text(aText) { };
+  ~PagePattern() { };
+
+  string Expand(const string& Keyword) const;
+  bool CanApply(const string& Keyword, const string& NextText, bool Last,
+                TextArena& Arena);
+  void Apply(Page& MyPage, const string& Keyword, bool Last,
+             TextArena& Arena) const;
+
+private:
+  void ApplyVerb(VerbBlock& Verb, const string& Keyword,
+                 TextArena& Arena) const;
+  void ApplyConditions(vector<VerbCondition>& Conditions,
+                       const string& Keyword, const string& NextText) const;
+  void ApplyBlock(Block& MyBlock, const string& Keyword,
+                  TextArena& Arena) const;
+  text_view ApplyText(const text_view& MyText, const string& Keyword,
+                      TextArena& Arena) const;
+
+
+public:
+  const string Name;
+  const string Text;
+
+private:
+  // verbs in the order the parser finished them, not flattened
+  vector<VerbBlock> Verbs;
+  // the state of the parser at the end, the text that follows carries on
+  // with the verb that was left open and its blocks
+  VerbBlock OpenVerb;
+  szt OpenBlocks = 0;
+  bool PopScopePending = false;
+  vector<VerbCondition> OpenConditions;
+  bool ScopePending = false;
+  bool Parsed = false;
+  bool Shareable = false;
+  bool Closed = false; // nothing carries over to the text that follows
+  bool VerbExpected = false; // the text that follows has to have a verb next
 
   friend class PageParser;
 };
@@ -4,7 +4,7 @@
 void PageParser::PrintBlock(string& BlockText,
                             const Block& Block)
 {
-  BlockText += Block.Expression;
+  BlockText.append(Block.Expression.Data, Block.Expression.Size);
   if (Block.Blocks.size()) {
     BlockText += token::Start[token::block];
     for (szt j = 0, fSz = Block.Blocks.size(); j < fSz; ++j) {
@@ -17,9 +17,11 @@ void PageParser::PrintBlock(string& BlockText,
 void PageParser::AddTextBlock()
 {
   // find the end of text at the next "
-  cszt textEnd = FindCharacter(Text, token::End[token::textBlock], ++Pos);
+  cszt textEnd = StoryLexer::FindToken(Tokens, token::End[token::textBlock],
+                                       ++Pos);
   const string& plainText = CutString(Text, Pos, textEnd);
   if (textEnd == string::npos) {
+    OpenEnded = true;
     LOG("Unmatched \" in segment - " + CutString(Text, Pos - 1, Pos + 20));
   }
   Pos = textEnd;
@@ -32,7 +34,7 @@ void PageParser::AddTextBlock()
       LOG("No verb to add the text to, maybe you forgot to close a \": "
           + plainText + " <-is this meant to be plain text?");
     } else {
-      Block newBlock(plainText);
+      Block newBlock(Arena.Add(plainText));
       newBlock.Execute = false;
       Blocks.back()->Blocks.push_back(newBlock);
     }
@@ -45,7 +47,7 @@ void PageParser::AddTextBlock()
 void PageParser::AddCondition()
 {
   // find the end, which ignores & | letting statements chain
-  cszt condEnd = FindNextStatement(++Pos);
+  cszt condEnd = StoryLexer::FindStatement(Tokens, ++Pos);
   const string& expression = CutString(Text, Pos, condEnd);
 
   // global condition have different scope handling
@@ -56,33 +58,21 @@ void PageParser::AddCondition()
     // we keep looking for a verb definition until we find it
     // or we hit something illegal
     // this is not ideal but allows for implied scope
-    cszt verbPos = FindTokenStart(Text, token::noun, condEnd);
-    if (verbPos < Length) {
-      // ignore if it's just another condition, otherwise
-      // only { block designations allowed between conditions and verbs
-      // no need to check for escaped characters as they will exit early
-      szt ignore = condEnd;
-      const char& condChar = token::Start[token::condition];
-      while (ignore < verbPos) {
-        if (Text[ignore] == token::Start[token::block]) {
-          ++ignore;
-        } else {
-          if (Text[ignore] == condChar) {
-            ignore = FindNextStatement(++ignore);
-          } else {
-            break;
-          }
-        }
+    cszt verbPos = min(FindVerbStart(Tokens, condEnd), Length);
+    // a pattern assumes the verb comes after it, checked once it's applied
+    if (SkipConditions(Text, Tokens, condEnd, verbPos) >= verbPos
+        && (verbPos < Length || MyPattern)) {
+      isVerbCondition = true;
+      if (verbPos >= Length) {
+        VerbExpected = true;
+        // unless a [ is waiting for its ] after the pattern
+        OpenEnded |= StoryLexer::FindToken(Tokens, token::Start[token::noun],
+                                           condEnd) != string::npos;
       }
-
-      if (ignore >= verbPos) {
-        isVerbCondition = true;
-        // we have to add the verb now so we can pop old verb conditions
-        // before we add this one to the pool
-        if (!Verb.Names.empty()) {
-          MyPage.AddVerb(Verb);
-          Verb.Reset();
-        }
+      // we have to add the verb now so we can pop old verb conditions
+      // before we add this one to the pool
+      if (!Verb.Names.empty()) {
+        FlushVerb();
       }
     }
   }
@@ -95,7 +85,22 @@ void PageParser::AddCondition()
     if (Pos < Length &&
         Text[Pos] == token::Start[token::block]) {
       // if the closing } doesn't exist it's set to be max size_t
-      condition.End = FindTokenEnd(Text, token::block, Pos);
+      condition.End = StoryLexer::FindPairEnd(Tokens,
+                                              token::Start[token::block],
+                                              token::End[token::block], Pos);
+      if (condition.End == string::npos && MyPattern) {
+        // the } can be in the text after the pattern
+        condition.Depth = 1;
+        for (const StoryToken& blockToken : Tokens) {
+          if (blockToken.Pos <= Pos) {
+            continue;
+          } else if (blockToken.Character == token::Start[token::block]) {
+            ++condition.Depth;
+          } else if (blockToken.Character == token::End[token::block]) {
+            --condition.Depth;
+          }
+        }
+      }
       ++Pos;
     } else {
       // end at size of text means implied scope of until we hit the next verb
@@ -125,7 +130,7 @@ void PageParser::AddCondition()
 
     // put a new block into the current block's array of blocks
     // and set it as the new current block
-    Block newBlock(expression);
+    Block newBlock(Arena.Add(expression));
     newBlock.Execute = true;
     Blocks.back()->Blocks.push_back(newBlock);
     Blocks.push_back(&(Blocks.back()->Blocks.back()));
@@ -144,12 +149,12 @@ void PageParser::AddCondition()
 void PageParser::AddInstruction()
 {
   // find the end, which ignores & | letting statements chain
-  cszt instEnd = FindNextStatement(++Pos);
+  cszt instEnd = StoryLexer::FindStatement(Tokens, ++Pos);
   if (Verb.Names.empty()) {
     LOG(CutString(Text, Pos, instEnd) +
         " - illegal instruction position, must be under a named verb");
   } else {
-    Block newBlock(CutString(Text, Pos, instEnd));
+    Block newBlock(Arena.Add(Text, Pos, instEnd));
     newBlock.Execute = true;
     Blocks.back()->Blocks.push_back(newBlock);
   }
@@ -182,15 +187,15 @@ void PageParser::PopOldVerbConditions()
 void PageParser::AddVerb()
 {
   // find the end of verb name at ]
-  szt verbEnd = FindCharacter(Text, token::End[token::noun], ++Pos);
+  szt verbEnd = StoryLexer::FindToken(Tokens, token::End[token::noun], ++Pos);
   if (verbEnd == string::npos) {
+    OpenEnded = true;
     LOG("Unmatched [ in segment - " + CutString(Text, Pos - 1, Pos + 20));
   }
 
   // flush the existing verb definition
   if (!Verb.Names.empty()) {
-    MyPage.AddVerb(Verb);
-    Verb.Reset();
+    FlushVerb();
   }
 
   // make sure this is a verb definition starting with a :
@@ -198,9 +203,8 @@ void PageParser::AddVerb()
     ++Pos;
     // find the end of the definition ]
     // or it can end with another verb name instead :
-    szt nameEnd = min(FindCharacter(Text, token::End[token::noun], Pos),
-                      FindCharacter(Text, token::Start[token::scope], Pos));
-    const string& verbName = CutString(Text, Pos, nameEnd);
+    szt nameEnd = FindNameEnd(Pos);
+    const text_view& verbName = Arena.Add(Text, Pos, nameEnd);
     Pos = nameEnd;
     // if the verb name is empty it will be hidden from the drop down menu
     Verb.VisualName = verbName;
@@ -213,9 +217,8 @@ void PageParser::AddVerb()
            && Text[Pos] == token::Start[token::scope]) {
       // get the next alias of the verb
       ++Pos;
-      nameEnd = min(FindCharacter(Text, token::End[token::noun], Pos),
-                    FindCharacter(Text, token::Start[token::scope], Pos));
-      Verb.Names.push_back(CutString(Text, Pos, nameEnd));
+      nameEnd = FindNameEnd(Pos);
+      Verb.Names.push_back(Arena.Add(Text, Pos, nameEnd));
       Pos = nameEnd;
     }
 
@@ -230,7 +233,7 @@ void PageParser::AddVerb()
       }
       verbExpression += VerbConditions[i].Expression;
     }
-    Verb.BlockTree.Expression = verbExpression;
+    Verb.BlockTree.Expression = Arena.Add(verbExpression);
   } else {
     LOG("Illegal token " + CutString(Text, Pos, verbEnd)
         + " expected : at start of it");
@@ -244,28 +247,152 @@ void PageParser::AddVerb()
   PopScopePending = false;
 }
 
-szt PageParser::FindNextStatement(cszt From)
+/** @brief Find the [ of the next verb the same way FindTokenStart would,
+  * only if it has its ]
+  * \return npos if there's no verb
+  */
+szt PageParser::FindVerbStart(const vector<StoryToken>& Tokens, cszt From)
+{
+  cszt verbPos = StoryLexer::FindToken(Tokens, token::Start[token::noun], From);
+  if (verbPos != string::npos
+      && StoryLexer::FindPairEnd(Tokens, token::Start[token::noun],
+                                 token::End[token::noun], verbPos)
+      != string::npos) {
+    return verbPos;
+  }
+  return string::npos;
+}
+
+/** @brief The verb name ends at ] or at the : of the next name
+  */
+szt PageParser::FindNameEnd(cszt From) const
+{
+  cszt verbEnd = StoryLexer::FindToken(Tokens, token::End[token::noun], From);
+  // the : only matters before the ]
+  return min(verbEnd, FindCharacter(Text, token::Start[token::scope], From,
+                                    verbEnd));
+}
+
+/** @brief Skip over conditions and { block designations
+  * \return where something else was found or at least To if there was nothing
+  */
+szt PageParser::SkipConditions(const text_view& Text,
+                               const vector<StoryToken>& Tokens,
+                               szt From,
+                               cszt To)
+{
+  // no need to check for escaped characters as they will exit early
+  const char& condChar = token::Start[token::condition];
+  while (From < To) {
+    if (Text[From] == token::Start[token::block]) {
+      ++From;
+    } else {
+      if (Text[From] == condChar) {
+        From = StoryLexer::FindStatement(Tokens, ++From);
+      } else {
+        break;
+      }
+    }
+  }
+  return From;
+}
+
+/** @brief Check if the text starts with a verb, maybe after conditions
+  * that would then belong to the verb
+  */
+bool PageParser::IsVerbNext(const string& Text)
 {
-  cszt textPos = FindCharacter(Text, token::Start[token::textBlock], From);
-  cszt nounPos = FindCharacter(Text, token::Start[token::noun], From);
-  cszt condPos = FindCharacter(Text, token::Start[token::condition], From);
-  cszt instPos = FindCharacter(Text, token::Start[token::instruction], From);
-  cszt blockPos = FindCharacter(Text, token::Start[token::block], From);
-  cszt blockEndPos = FindCharacter(Text, token::End[token::block], From);
-  // TODO: take a guess
-  return min(textPos,
-             min(nounPos,
-                 min(condPos,
-                     min(instPos,
-                         min(blockPos, blockEndPos)))));
+  vector<StoryToken> tokens;
+  StoryLexer::FindTokens(Text, tokens);
+  cszt verbPos = FindVerbStart(tokens, 0);
+  return verbPos != string::npos
+         && SkipConditions(Text, tokens, 0, verbPos) >= verbPos;
 }
 
+/** @brief Add the finished verb to the page or keep it in the pattern
+  */
+void PageParser::FlushVerb()
+{
+  if (MyPattern) {
+    MyPattern->Verbs.push_back(Verb);
+  } else {
+    MyPage->AddVerb(Verb);
+  }
+  Verb.Reset();
+}
+
+/** @brief Parse the page text and finish all the verbs of the page,
+  * if the text follows a pattern it carries on from where that ended
+  */
 PageParser::PageParser(const string& SourceText,
-                       Page& aMyPage)
-  : Text(SourceText), MyPage(aMyPage)
+                       Page& aMyPage,
+                       TextArena& aArena,
+                       const PagePattern* Previous)
+  : Text(SourceText), MyPage(&aMyPage), Arena(aArena)
+{
+  StoryLexer::FindTokens(Text, Tokens);
+  if (Previous) {
+    ContinuePattern(*Previous);
+  }
+  Parse();
+  Finish();
+}
+
+/** @brief Parse the pattern on its own, the verbs are kept unfinished so they
+  * can be copied into the pages and the state at the end is kept for the
+  * text of the noun that follows it
+  */
+PageParser::PageParser(const string& SourceText,
+                       PagePattern& aMyPattern,
+                       TextArena& aArena)
+  : Text(SourceText), MyPattern(&aMyPattern), Arena(aArena)
+{
+  StoryLexer::FindTokens(Text, Tokens);
+  Parse();
+  // an escape at the end would escape the [ of the next verb
+  if (Length && Text[Length - 1] == '\\') {
+    OpenEnded = true;
+  }
+
+  // keep the state at the end for the text that follows
+  PagePattern& pattern = *MyPattern;
+  pattern.Shareable = !OpenEnded;
+  pattern.VerbExpected = VerbExpected;
+  pattern.OpenVerb = Verb;
+  pattern.OpenBlocks = Blocks.size();
+  pattern.PopScopePending = PopScopePending;
+  pattern.OpenConditions = VerbConditions;
+  pattern.ScopePending = VerbScopePending;
+  // a verb after it pops the conditions unless they were added after
+  // the last one or their { } goes on past the end
+  pattern.Closed = VerbScopePending;
+  for (const VerbCondition& condition : VerbConditions) {
+    pattern.Closed &= !condition.Depth;
+  }
+}
+
+/** @brief Start from the state the parser was in at the end of the pattern
+  * as if the text followed it, with the pattern name replaced
+  */
+void PageParser::ContinuePattern(const PagePattern& Pattern)
+{
+  const string& keyword = MyPage->Keyword;
+  Verb = Pattern.OpenVerb;
+  Pattern.ApplyVerb(Verb, keyword, Arena);
+  // each block on the stack is the last one in the block below it
+  for (szt i = 0; i < Pattern.OpenBlocks; ++i) {
+    Blocks.push_back(i ? &Blocks.back()->Blocks.back() : &Verb.BlockTree);
+  }
+  PopScopePending = Pattern.PopScopePending;
+  VerbScopePending = Pattern.ScopePending;
+  Pattern.ApplyConditions(VerbConditions, keyword, Text);
+}
+
+void PageParser::Parse()
 {
   Length = Text.size();
-  while (Pos < Length) {
+  // a pattern stops at the first thing it can't be shared with
+  while (Pos < Length && !(MyPattern && OpenEnded)) {
     const char c = Text[Pos];
     if (c == token::Start[token::textBlock]) { // "
       AddTextBlock();
@@ -288,27 +415,35 @@ PageParser::PageParser(const string& SourceText,
     } else {
       LOG(string("Illegal token ") + c + " near " + CutString(Text, Pos, Pos + 20));
       ++Pos;
+      // the rest is ignored, including whatever follows the text
+      OpenEnded = true;
       break;
     }
   }
+}
 
+/** @brief Write the normalised text of the page and flatten the verbs
+  */
+void PageParser::Finish()
+{
   if (!Verb.Names.empty()) {
-    MyPage.AddVerb(Verb);
+    FlushVerb();
   }
 
   string ParsedText;
-  for (szt i = 0, fSz = MyPage.Verbs.size(); i < fSz; ++i) {
-    Block& topBlock = MyPage.Verbs[i].BlockTree;
-    ParsedText += topBlock.Expression;
-    for (szt j = 0, fSzj = MyPage.Verbs[i].Names.size(); j < fSzj; ++j) {
+  for (szt i = 0, fSz = MyPage->Verbs.size(); i < fSz; ++i) {
+    Block& topBlock = MyPage->Verbs[i].BlockTree;
+    ParsedText.append(topBlock.Expression.Data, topBlock.Expression.Size);
+    for (szt j = 0, fSzj = MyPage->Verbs[i].Names.size(); j < fSzj; ++j) {
       ParsedText = ParsedText + token::Start[token::noun]
                    + token::Start[token::scope]
-                   + MyPage.Verbs[i].Names[j] + token::End[token::noun];
+                   + MyPage->Verbs[i].Names[j].str() + token::End[token::noun];
     }
     for (szt j = 0, fSzj = topBlock.Blocks.size(); j < fSzj; ++j) {
       PrintBlock(ParsedText, topBlock.Blocks[j]);
     }
+    MyPage->Verbs[i].Flatten();
   }
 
-  MyPage.Text = ParsedText;
+  MyPage->Text = ParsedText;
 }
@@ -3,20 +3,30 @@
 
 #include "main.h"
 #include "page.h"
-
-struct VerbCondition {
-  string Expression;
-  szt End;
-};
+#include "textarena.h"
+#include "storylexer.h"
 
 class PageParser
 {
 public:
-  PageParser(const string& SourceText, Page& _MyPage);
+  PageParser(const string& SourceText, Page& aMyPage, TextArena& aArena,
+             const PagePattern* Previous = NULL);
+  PageParser(const string& SourceText, PagePattern& aMyPattern,
+             TextArena& aArena);
   ~PageParser() { };
 
+  static bool IsVerbNext(const string& Text);
+
 private:
-  szt FindNextStatement(cszt From);
+  void Parse();
+  void Finish();
+  void ContinuePattern(const PagePattern& Pattern);
+  void FlushVerb();
+  szt FindNameEnd(cszt From) const;
+  static szt FindVerbStart(const vector<StoryToken>& Tokens, cszt From);
+  static szt SkipConditions(const text_view& Text,
+                            const vector<StoryToken>& Tokens, szt From,
+                            cszt To);
 
   void AddTextBlock();
   void AddCondition();
@@ -36,10 +46,17 @@ private:
   szt Length;
   bool PopScopePending = false;
   bool VerbScopePending = false;
+  // the parse of a pattern depends on what follows it
+  bool OpenEnded = false;
+  bool VerbExpected = false;
 
-  // passed in by the page that created the parser
+  // passed in by the page or the pattern that created the parser
   const string& Text;
-  Page& MyPage;
+  // statement characters of the text in order
+  vector<StoryToken> Tokens;
+  Page* MyPage = NULL;
+  PagePattern* MyPattern = NULL;
+  TextArena& Arena;
 };
 
 #endif // PAGEPARSER_H
@@ -1,7 +1,7 @@
 #include "properties.h"
 #include "tokens.h"
 
-Properties::Properties(const string& Value) : IntValue(0)
+Properties::Properties(const text_view& Value) : IntValue(0)
 {
   szt pos = 0;
   cszt length = Value.size();
@@ -11,7 +11,7 @@ Properties::Properties(const string& Value) : IntValue(0)
 
     // is it a number?
     if (Value[pos] == token::Start[token::number]) {
-      IntValue = IntoInt(CutString(Value, pos + 1, endPos));
+      IntValue = IntoInt(CutView(Value, pos + 1, endPos));
     } else {
       // in case there is an escaped # (madness)
       if (Value[pos] == '\\') {
@@ -124,11 +124,7 @@ bool Properties::AddValues(const Properties& Value)
   */
 bool Properties::ConcatValues(const Properties& Value)
 {
-  for (string& text : TextValues) {
-    for (const string& textAdded : Value.TextValues) {
-      text += textAdded;
-    }
-  }
+  TextValues.AppendToAll(Value.TextValues);
   return !TextValues.empty() && !Value.TextValues.empty();
 }
 
@@ -138,17 +134,7 @@ bool Properties::ConcatValues(const Properties& Value)
   */
 bool Properties::CommonValues(const Properties& Value)
 {
-  bool changed = false;
-  Properties common;
-  for (const string& text : TextValues) {
-    if (Value.ContainsValue(text)) {
-      common.AddValue(text);
-    } else {
-      changed = true;
-    }
-  }
-  TextValues = common.TextValues;
-  return changed;
+  return TextValues.KeepCommon(Value.TextValues);
 }
 
 /** @brief Remove all TextValues from the pased in Values if needed
@@ -157,11 +143,11 @@ bool Properties::CommonValues(const Properties& Value)
   */
 bool Properties::RemoveValues(const Properties& Value)
 {
-  bool changed = false;
-  for (const string& text : Value.TextValues) {
-    changed |= RemoveValue(text);
+  if (TextValues.RemoveAll(Value.TextValues)) {
+    Dirty = true;
+    return true;
   }
-  return changed;
+  return false;
 }
 
 /** @brief Replace old values with new ones (except Int)
@@ -2,12 +2,13 @@
 #define PROPERTIES_H
 
 #include "main.h"
+#include "valueset.h"
 
 class Properties
 {
 public:
   Properties() { };
-  explicit Properties(const string& Value);
+  explicit Properties(const text_view& Value);
   ~Properties() { };
 
   inline bool ContainsValue(const string& Value) const;
@@ -41,7 +42,7 @@ public:
 
 public:
   lint IntValue = 0;
-  vector<string> TextValues;
+  ValueSet TextValues;
   bool Dirty = true;
 };
 
@@ -57,16 +58,10 @@ bool Properties::IsEmpty() const
 }
 
 /** @brief Check if a value is there
-  * Done on a vector since the set will usually be small (mostly 1)
   */
 bool Properties::ContainsValue(const string& Value) const
 {
-  for (const string& text : TextValues) {
-    if (text == Value) {
-      return true;
-    }
-  }
-  return false;
+  return TextValues.Contains(Value);
 }
 
 /** @brief Contains all the value of the passed in Value
@@ -87,10 +82,9 @@ bool Properties::ContainsValues(const Properties& Value) const
   */
 bool Properties::AddValue(const string& Value)
 {
-  if (ContainsValue(Value) || Value.empty()) {
+  if (Value.empty() || !TextValues.Add(Value)) {
     return false;
   }
-  TextValues.push_back(Value);
   Dirty = true;
   return true;
 }
@@ -100,20 +94,11 @@ bool Properties::AddValue(const string& Value)
   */
 bool Properties::RemoveValue(const string& Value)
 {
-  if (Value.empty()) {
+  if (Value.empty() || !TextValues.Remove(Value)) {
     return false;
   }
-  // iterators have the most annoying syntax
-  // not using erase-remove because elements are unique so we can return early
-  auto it = TextValues.begin();
-  for (auto endIt = TextValues.end(); it != endIt; ++it) {
-    if (*it == Value) {
-      TextValues.erase(it);
-      Dirty = true;
-      return true;
-    }
-  }
-  return false;
+  Dirty = true;
+  return true;
 }
 
 /** @brief Set Value
@@ -1,6 +1,7 @@
 #include "reader.h"
 #include "audio.h"
 #include "input.h"
+#include "storyquery.h"
 
 #ifdef DEVBUILD
 #include "disk.h"
@@ -19,6 +20,7 @@ const string SKEY_LAYOUTSV = "layouts vertical";
 const string SKEY_SCREENW = "screen width";
 const string SKEY_SCREENH = "screen height";
 const string SKEY_GRID = "grid size";
+const string SKEY_VERB_CODE = "verb code";
 
 const string QUICK_BOOKMARK = "Quick bookmark";
 
@@ -79,6 +81,10 @@ void Reader::LoadSettings()
     }
   }
   Settings.GetValue(SKEY_GRID, GRID);
+  // 1 runs the verbs from the compiled verb code instead of the blocks
+  szt verbCode = StoryQuery::UseVerbCode;
+  Settings.GetValue(SKEY_VERB_CODE, verbCode);
+  StoryQuery::UseVerbCode = verbCode;
 
   Timeout = MIN_TIMEOUT;
 }
@@ -105,6 +111,7 @@ void Reader::SaveSettings()
   Settings.SetValue(SKEY_SCREENW, Width);
   Settings.SetValue(SKEY_SCREENH, Height);
   Settings.SetValue(SKEY_GRID, GRID);
+  Settings.SetValue(SKEY_VERB_CODE, (szt)StoryQuery::UseVerbCode);
 }
 
 bool Reader::InitFonts()
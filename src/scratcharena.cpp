@@ -0,0 +1,51 @@
+#include "scratcharena.h"
+
+// entries kept between turns, anything past that was a one off deep nesting
+cszt SCRATCH_KEEP_VALUES = 256;
+cszt SCRATCH_KEEP_COMPILED = 16;
+
+/** @brief Hand out Count reset entries in a row
+  * \return index of the first one
+  */
+szt ScratchArena::AddValues(cszt Count)
+{
+  cszt first = ValuesUsed;
+  ValuesUsed += Count;
+  while (Values.size() < ValuesUsed) {
+    Values.emplace_back();
+  }
+  for (szt i = first; i < ValuesUsed; ++i) {
+    ScratchValues& entry = Values[i];
+    entry.Values.Reset();
+    entry.Nested = true;
+  }
+  return first;
+}
+
+/** @brief Empty compiled expressions for text that wasn't compiled with
+  * its verb, they keep the capacity of their arrays from previous use
+  */
+CompiledExpressions& ScratchArena::AddCompiled()
+{
+  if (Compiled.size() == CompiledUsed) {
+    Compiled.emplace_back();
+  }
+  CompiledExpressions& compiled = Compiled[CompiledUsed++];
+  compiled.Clear();
+  return compiled;
+}
+
+/** @brief Called once the queue has been processed, drops the entries
+  * beyond what a normal turn needs
+  */
+void ScratchArena::EndTurn()
+{
+  ValuesUsed = 0;
+  CompiledUsed = 0;
+  if (Values.size() > SCRATCH_KEEP_VALUES) {
+    Values.resize(SCRATCH_KEEP_VALUES);
+  }
+  if (Compiled.size() > SCRATCH_KEEP_COMPILED) {
+    Compiled.resize(SCRATCH_KEEP_COMPILED);
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include "main.h"
+#include "properties.h"
+#include "compiledexpressions.h"
+#include <deque>
+
+/** @brief Temporary values of an expression being evaluated,
+  * Nested is only used by the operation stack of EvaluateExpression
+  */
+struct ScratchValues {
+  Properties Values;
+  bool Nested = true;
+};
+
+/** @brief How much of the arena was in use, taken before adding to it
+  */
+struct ScratchMark {
+  szt Values;
+  szt Compiled;
+};
+
+/** @brief Owns the temporaries used while a turn is being processed
+  *
+  * Evaluation nests through verbs and function calls so the entries are
+  * handed out like a stack and released back to a mark. They're only reset,
+  * never freed, so their buffers get reused by the next expression and the
+  * next turn. Entries live in deques so references stay valid as it grows.
+  */
+class ScratchArena
+{
+public:
+  ScratchArena() { };
+  ~ScratchArena() { };
+
+  szt AddValues(cszt Count);
+  inline Properties& AddValues();
+  CompiledExpressions& AddCompiled();
+  inline ScratchValues& operator[](cszt Index);
+
+  inline ScratchMark GetMark() const;
+  inline void Release(const ScratchMark& Mark);
+  void EndTurn();
+
+private:
+  std::deque<ScratchValues> Values;
+  std::deque<CompiledExpressions> Compiled;
+  szt ValuesUsed = 0;
+  szt CompiledUsed = 0;
+};
+
+/** @brief Releases everything added to the arena during its lifetime
+  */
+class ScratchScope
+{
+public:
+  explicit ScratchScope(ScratchArena& Arena)
+    : Scratch(Arena), Mark(Arena.GetMark()) { };
+  ~ScratchScope()
+  {
+    Scratch.Release(Mark);
+  };
+
+private:
+  ScratchArena& Scratch;
+  const ScratchMark Mark;
+};
+
+/** @brief Single reset Properties for a temporary result
+  */
+Properties& ScratchArena::AddValues()
+{
+  return Values[AddValues(1)].Values;
+}
+
+ScratchValues& ScratchArena::operator[](cszt Index)
+{
+  return Values[Index];
+}
+
+ScratchMark ScratchArena::GetMark() const
+{
+  return { ValuesUsed, CompiledUsed };
+}
+
+void ScratchArena::Release(const ScratchMark& Mark)
+{
+  ValuesUsed = Mark.Values;
+  CompiledUsed = Mark.Compiled;
+}
+
+#endif // SCRATCHARENA_H
@@ -1,5 +1,7 @@
 #include "session.h"
 #include "disk.h"
+#include "writequeue.h"
+#include <algorithm>
 
 /** @brief you need to init system nouns beforehand
   */
@@ -11,14 +13,16 @@ bool Session::LoadSnapshot(cszt Index)
     return false;
   }
   CurrentSnapshot = Index;
+  // values are replaced wholesale without going through the queries
+  ClearVerbs();
   szt queueI = Snapshots[Index].QueueIndex;
   szt assetI = Snapshots[Index].AssetsIndex;
   szt changeI = Snapshots[Index].ChangesIndex;
 
   // load the current queue
   if (queueI > 0) {
-    const string& queueValue = QueueHistory[--queueI];
-    *QueueNoun = Properties(queueValue);
+    const uint queueValue = QueueHistory[--queueI];
+    *QueueNoun = Properties(HistoryTexts.Get(queueValue));
   } else {
     // this is at the start of the book, no loading needed
     return false;
@@ -26,75 +30,177 @@ bool Session::LoadSnapshot(cszt Index)
 
   // find the most up to date positions of value histories for each history
   vector<szt> currentIndex;
-  currentIndex.resize(ValuesHistories.size(), 0);
-  for (szt i = 0; i < changeI; ++i) {
-    cszt_pair& change = ValuesChanges[i];
-    currentIndex[change.X] = change.Y;
-  }
+  FindHistoryIndices(changeI, currentIndex);
 
-  for (const auto& value : ValuesHistoryNames) {
-    const string& name = value.first;
-    cszt i = value.second;
+  for (szt i = 0, fSz = ValuesHistoryNames.size(); i < fSz; ++i) {
+    const uint symbol = ValuesHistoryNames[i];
+    if (symbol == NO_SYMBOL) {
+      continue;
+    }
     // all indeces here are 1-based, 0 meaning book values should be used
     if (currentIndex[i]) {
       // it's safe to decrement as it's a temporary
-      const string& oldValue = ValuesHistories[i][--currentIndex[i]];
-      UserValues[name] = Properties(oldValue);
+      const uint oldValue = ValuesHistories[i][--currentIndex[i]];
+      AddUserValues(symbol) = Properties(HistoryTexts.Get(oldValue));
+      ListValues(symbol);
     } else {
       // remove user values that are the same as in the book
       // because we don't have a record of the initial state
-      auto it = UserValues.find(name);
-      if (it != UserValues.end()) {
-        // but don't remove system nouns, they are initialised
-        bool nonSystem = true;
-        for (const Properties* systemNoun : SystemNouns) {
-          if (&(it->second) == systemNoun) {
-            nonSystem = false;
-            break;
-          }
-        }
-        if (nonSystem) {
-          UserValues.erase(it);
-        }
+      // but don't remove system nouns, they are initialised
+      const Properties* values = FindUserValues(symbol);
+      if (values && !IsSystemValues(values)) {
+        UserValues[symbol].reset();
       }
     }
   }
+  ReorderedValues.clear();
 
-  AssetStates.clear();
-  // assetI 0 means all assets are off
-  if (assetI > 0) {
-    const string& assets = AssetsHistory[--assetI];
-    szt lastPos = 0;
-    szt pos = FindCharacter(assets, '\n', lastPos);
+  SetAssetStates(assetI);
+  LoadedSnapshot = Index;
 
-    while (pos != string::npos && pos > lastPos) {
-      const string& assetName = CutString(assets, lastPos, pos);
-      AssetStates[assetName] = true;
-      lastPos = ++pos;
-      pos = FindCharacter(assets, '\n', lastPos);
+  return true;
+}
+
+/** @brief Move to a neighbouring snapshot by only replacing the values
+  * changed in between and the ones written to since the last load
+  * \return false if the snapshot needs to be loaded in full instead
+  */
+bool Session::StepSnapshot(cszt Index)
+{
+  if (LoadedSnapshot == NO_SNAPSHOT || Index >= Snapshots.size() || !Index
+      || !Snapshots[Index].QueueIndex) {
+    return false;
+  }
+  const Snapshot& from = Snapshots[LoadedSnapshot];
+  const Snapshot& to = Snapshots[Index];
+  cszt fromI = from.ChangesIndex;
+  cszt toI = to.ChangesIndex;
+  // past this it's cheaper to load all the histories
+  if (max(fromI, toI) - min(fromI, toI) > ValuesHistories.size()) {
+    return false;
+  }
+
+  // symbols with the 1-based positions in their histories they go back to,
+  // values written to since the load first
+  vector<szt_pair> restore;
+  vector<uint> written = ListedValues;
+  written.insert(written.end(), ReorderedValues.begin(),
+                 ReorderedValues.end());
+  for (const uint symbol : written) {
+    cszt historyIndex = symbol < ValuesHistoryIndex.size() ?
+                        ValuesHistoryIndex[symbol] : 0;
+    cszt position = historyIndex ?
+                    FindHistoryIndex(toI, historyIndex - 1) : 0;
+    restore.push_back(szt_pair(symbol, position));
+  }
+  // then the changes in between in the order they'd be undone or redone
+  vector<szt_pair> changes;
+  if (toI < fromI) {
+    ValuesChanges.Read(toI, fromI, changes);
+    for (szt i = changes.size(); i > 0; --i) {
+      cszt_pair& change = changes[i - 1];
+      restore.push_back(szt_pair(ValuesHistoryNames[change.X], change.Y - 1));
     }
-    if (lastPos < assets.size()) {
-      // last value doesn't have a \n at the end
-      const string& assetName = CutString(assets, lastPos);
-      AssetStates[assetName] = true;
+  } else {
+    ValuesChanges.Read(fromI, toI, changes);
+    for (cszt_pair& change : changes) {
+      restore.push_back(szt_pair(ValuesHistoryNames[change.X], change.Y));
+    }
+  }
+  // going back to book values of system nouns needs the story
+  for (cszt_pair& value : restore) {
+    if (!value.Y && value.X != NO_SYMBOL) {
+      const Properties* values = FindUserValues(value.X);
+      if (values && values != QueueNoun && IsSystemValues(values)) {
+        return false;
+      }
     }
   }
 
+  CurrentSnapshot = Index;
+  const uint queueValue = QueueHistory[to.QueueIndex - 1];
+  *QueueNoun = Properties(HistoryTexts.Get(queueValue));
+  TouchValues(Symbols.Find(QUEUE));
+
+  // everything written to is put back below
+  for (const uint symbol : ListedValues) {
+    ValuesListed[symbol] = false;
+  }
+  ListedValues.clear();
+  ReorderedValues.clear();
+
+  for (cszt_pair& value : restore) {
+    const uint symbol = value.X;
+    if (symbol == NO_SYMBOL) {
+      continue;
+    }
+    if (value.Y) {
+      cszt historyI = ValuesHistoryIndex[symbol] - 1;
+      const uint oldValue = ValuesHistories[historyI][value.Y - 1];
+      AddUserValues(symbol) = Properties(HistoryTexts.Get(oldValue));
+      // dirty and listed like loaded values, the end of their histories
+      // may be past them so the next snapshot has to compare them
+      ListValues(symbol);
+      ValuesChanged = true;
+    } else {
+      const Properties* values = FindUserValues(symbol);
+      if (values && values != QueueNoun) {
+        UserValues[symbol].reset();
+      }
+    }
+    // verbs cached with the replaced values are no longer valid
+    TouchValues(symbol);
+  }
+
+  if (to.AssetsIndex != from.AssetsIndex || AssetsChanged) {
+    SetAssetStates(to.AssetsIndex);
+  }
+  LoadedSnapshot = Index;
   return true;
 }
 
-/** @brief parses the save file and fills histories (does't load any snapshot)
+/** @brief reads the save file, fills histories and loads the last snapshot
+  * sessions saved as text are written again as a journal
   */
-bool Session::Load()
+bool Session::Load(WriteQueue& Writer)
 {
-  File Save;
+  // the file may still be queued to be written
+  Writer.Flush();
   const string& savePath = STORY_DIR + SLASH + BookName + SLASH
                            + Filename + SESSION_EXT;
-  if (!Disk::Exists(savePath) || !Save.Read(savePath)) {
+  if (!Disk::Exists(savePath)) {
     LOG(savePath + " - save file missing");
     return false;
   }
 
+  if (SessionJournal::IsJournal(savePath)) {
+    if (!Journal.Load(savePath, *this)) {
+      return false;
+    }
+    // only the keyframes past the last one in the file are worked out,
+    // older files and ones with a damaged end don't have them all
+    AddKeyframes();
+  } else {
+    File Save;
+    if (!Save.Read(savePath)) {
+      LOG(savePath + " - save file missing");
+      return false;
+    }
+    LoadText(Save);
+    Journal.Save(savePath, *this, Writer);
+  }
+
+  LastValues.clear();
+  BookmarksChanged = false;
+  // repeat last snapshot
+  LoadSnapshot(Snapshots.size() - 1);
+  return true;
+}
+
+/** @brief parses the older text save file and fills histories
+  */
+void Session::LoadText(File& Save)
+{
   string buffer;
   Save.GetLine(buffer); // session name:
   Save.GetLine(Name);
@@ -107,7 +213,7 @@ bool Session::Load()
 
   // queue
   while (Save.GetLine(buffer)) {
-    QueueHistory.push_back(buffer);
+    QueueHistory.push_back(HistoryTexts.Add(buffer));
   }
 
   // assets
@@ -120,7 +226,7 @@ bool Session::Load()
       historyEntry += "\n";
       historyEntry += buffer;
     }
-    AssetsHistory.push_back(historyEntry);
+    AssetsHistory.push_back(HistoryTexts.Add(historyEntry));
   }
 
   // values
@@ -128,36 +234,33 @@ bool Session::Load()
   Save.GetLine(buffer); // #
   // resize the array to fit all the values tracked
   ValuesHistories.resize(IntoSizeT(buffer));
+  ValuesHistoryNames.resize(ValuesHistories.size(), NO_SYMBOL);
   Save.GetLine(buffer);
   while (Save.GetLine(buffer)) {
     string indexBuffer;
     Save.GetLine(indexBuffer);
     cszt index = IntoSizeT(indexBuffer);
-    ValuesHistoryNames[buffer] = IntoSizeT(index);
+    SetValuesHistory(Symbols.Add(buffer), index);
     while (Save.GetLine(buffer)) {
-      ValuesHistories[index].push_back(buffer);
+      ValuesHistories[index].push_back(HistoryTexts.Add(buffer));
     }
   }
 
   // changes
   while (Save.GetLine(buffer)) {
     cszt pos = FindCharacter(buffer, VALUE_SEPARATOR);
-    const string& valueIndex = CutString(buffer, 0, pos);
-    const string& changeIndex = CutString(buffer, pos + 1);
-    cszt_pair change(IntoSizeT(valueIndex), IntoSizeT(changeIndex));
-    ValuesChanges.push_back(change);
+    cszt_pair change(IntoSizeT(CutView(buffer, 0, pos)),
+                     IntoSizeT(CutView(buffer, pos + 1)));
+    ValuesChanges.Add(change);
   }
 
   // snapshots
   while (Save.GetLine(buffer)) {
     cszt pos = FindCharacter(buffer, VALUE_SEPARATOR);
     cszt pos2 = FindCharacter(buffer, VALUE_SEPARATOR, pos + 1);
-    const string& queueIndex = CutString(buffer, 0, pos);
-    const string& assetIndex = CutString(buffer, pos + 1, pos2);
-    const string& changeIndex = CutString(buffer, pos2 + 1);
-    const Snapshot loadedSnapshot(IntoSizeT(queueIndex),
-                                  IntoSizeT(assetIndex),
-                                  IntoSizeT(changeIndex));
+    const Snapshot loadedSnapshot(IntoSizeT(CutView(buffer, 0, pos)),
+                                  IntoSizeT(CutView(buffer, pos + 1, pos2)),
+                                  IntoSizeT(CutView(buffer, pos2 + 1)));
     Snapshots.push_back(loadedSnapshot);
   }
 
@@ -171,83 +274,22 @@ bool Session::Load()
     Bookmarks[index].Description = bookmarkDescription;
   }
 
-  // repeat last snapshot
-  LoadSnapshot(Snapshots.size() - 1);
-  return true;
+  // text saves have no keyframes, they all get worked out
+  ValuesKeyframes.clear();
+  AddKeyframes();
 }
 
-/** @brief get the string for the whole session, ready for writing into a file
+/** @brief append the turns played since the last save to the save file,
+  * the writer only gets to it after this returns
   */
-const string Session::GetSessionText() const
+bool Session::Save(const string& SavePath, WriteQueue& Writer)
 {
-  string text;
-  text.reserve(1024 * 1024); // reserve a meg outright
-  // basic info
-  text += "Session name:\n";
-  text += Name;
-  text += "\nBook title:\n";
-  text += BookName;
-  // queue
-  text += "\n\nSteps taken:\n";
-  text += IntoString(QueueHistory.size());
-  text += "\n\n";
-  for (const string& value : QueueHistory) {
-    text += value;
-    text += '\n';
-  }
-  // assets
-  text += "\nAsset states:\n";
-  text += IntoString(AssetsHistory.size());
-  text += "\n\n";
-  for (const string& value : AssetsHistory) {
-    text += value;
-    text += "\n\n";
-  }
-  // history of all values
-  text += "\nTracked Values:\n";
-  text += IntoString(ValuesHistoryNames.size());
-  text += "\n\n";
-  for (const auto& valueMap : ValuesHistoryNames) {
-    text += valueMap.first;
-    text += '\n';
-    text += IntoString(valueMap.second);
-    text += '\n';
-    for (const string& value : ValuesHistories[valueMap.second]) {
-      text += value;
-      text += '\n';
-    }
-    text += '\n';
-  }
-  text += '\n';
-  // value change indexes
-  for (cszt_pair& value : ValuesChanges) {
-    text += IntoString(value.X);
-    text += VALUE_SEPARATOR;
-    text += IntoString(value.Y);
-    text += '\n';
-  }
-  text += '\n';
-  // snapshots (don't save the first snapshot, it's part of initialisation)
-  for (szt i = 1, fSz = Snapshots.size(); i < fSz; ++i) {
-    const Snapshot& value = Snapshots[i];
-    text += IntoString(value.QueueIndex);
-    text += VALUE_SEPARATOR;
-    text += IntoString(value.AssetsIndex);
-    text += VALUE_SEPARATOR;
-    text += IntoString(value.ChangesIndex);
-    text += '\n';
-  }
-  text += '\n';
-  // bookmarks, queueindex and description
-  for (const auto& value : Bookmarks) {
-    text += IntoString(value.first);
-    text += '\n';
-    text += value.second.Description;
-    text += "\n\n";
+  if (!Journal.Save(SavePath, *this, Writer)) {
+    LOG(SavePath + " - failed to save the session");
+    return false;
   }
-  text += "\nEnd of session file";
-
-  return text;
+  BookmarksChanged = false;
+  return true;
 }
 
 /** @brief Return the user values ready for writing to a file
@@ -255,14 +297,21 @@ const string Session::GetSessionText() const
 string Session::GetUserValuesText() const
 {
   string text;
-  for (const auto& valuePair : UserValues) {
+  vector<uint> nouns;
+  for (szt i = 0, fSz = UserValues.size(); i < fSz; ++i) {
+    if (UserValues[i]) {
+      nouns.push_back(i);
+    }
+  }
+  Symbols.SortByName(nouns);
+  for (const uint symbol : nouns) {
     // skip queue noun
-    if (&valuePair.second == SystemNouns[systemQueue]) {
+    if (UserValues[symbol].get() == SystemNouns[systemQueue]) {
       break;
     }
-    text += valuePair.first;
+    text += Symbols.GetName(symbol);
     text += '=';
-    text += valuePair.second.PrintValues();
+    text += UserValues[symbol]->PrintValues();
     text += '\n';
   }
   return text;
@@ -281,16 +330,18 @@ string Session::GetQueueValuesText() const
 string Session::GetAssetStatesText() const
 {
   string text;
-  bool addBreak = false;
-  for (const auto& valuePair : AssetStates) {
-    if (valuePair.second.Playing) {
-      if (addBreak) {
-        text += '\n';
-      } else {
-        addBreak = true;
-      }
-      text += valuePair.first;
+  vector<uint> playing;
+  for (szt i = 0, fSz = AssetStates.size(); i < fSz; ++i) {
+    if (AssetStates[i].Playing) {
+      playing.push_back(i);
+    }
+  }
+  Symbols.SortByName(playing);
+  for (szt i = 0, fSz = playing.size(); i < fSz; ++i) {
+    if (i) {
+      text += '\n';
     }
+    text += Symbols.GetName(playing[i]);
   }
   return text;
 }
@@ -299,49 +350,92 @@ void Session::Trim()
 {
   // don't trim at the end
   if (CurrentSnapshot < Snapshots.size()) {
-    Snapshots.resize(CurrentSnapshot);
-    Snapshot& trimSnapshot = Snapshots.back();
-    // keep in mind that indices below are 1-based
-    QueueHistory.resize(trimSnapshot.QueueIndex);
-
-    // find the highest indices of values histories used until the trim
-    vector<szt> biggestIndex;
-    biggestIndex.resize(ValuesHistories.size(), 0);
-    for (szt i = 0; i < trimSnapshot.ChangesIndex; ++i) {
-      cszt_pair& change = ValuesChanges[i];
-      if (change.Y > biggestIndex[change.X]) {
-        biggestIndex[change.X] = change.Y;
+    cszt loadedChanges = LoadedSnapshot != NO_SNAPSHOT ?
+                         Snapshots[LoadedSnapshot].ChangesIndex
+                         : ValuesChanges.size();
+    cszt trimChanges = Snapshots[CurrentSnapshot - 1].ChangesIndex;
+    // values stepped to aren't all dirty like loaded ones, those that
+    // might differ from their trimmed histories need to be checked again
+    vector<szt_pair> changes;
+    ValuesChanges.Read(min(loadedChanges, trimChanges),
+                       ValuesChanges.size(), changes);
+    for (cszt_pair& change : changes) {
+      const uint symbol = ValuesHistoryNames[change.X];
+      Properties* values = FindUserValues(symbol);
+      if (values) {
+        values->Dirty = true;
+        ListValues(symbol);
+        ValuesChanged = true;
       }
     }
-    // trim all values histories beyond that index
-    for (szt i = 0; i < ValuesHistories.size(); ++i) {
-      ValuesHistories[i].resize(biggestIndex[i]);
+    TrimHistories(CurrentSnapshot);
+    // the histories no longer continue what's in the file
+    Journal.Reset();
+    if (LoadedSnapshot != NO_SNAPSHOT && LoadedSnapshot >= Snapshots.size()) {
+      LoadedSnapshot = NO_SNAPSHOT;
     }
-    ValuesChanges.resize(trimSnapshot.ChangesIndex);
+  }
+}
 
-    // find the biggest index of asset changes and trim the rest
-    szt maxAssetStateIndex = 0;
-    for (const Snapshot& snap : Snapshots) {
-      if (snap.AssetsIndex > maxAssetStateIndex) {
-        maxAssetStateIndex = snap.AssetsIndex;
+/** @brief Drop the snapshots after the current one to continue from there
+  * in a new file, the session needs to be saved first as the new file only
+  * gets what follows and refers to this one for the histories before that
+  */
+void Session::Branch()
+{
+  Trim();
+  Journal.Fork(Filename, *this);
+}
+
+/** @brief Cut all the histories back to how they were at the snapshot
+  */
+void Session::TrimHistories(cszt SnapshotCount)
+{
+  Snapshots.resize(SnapshotCount);
+  const Snapshot& trimSnapshot = Snapshots.back();
+  // keep in mind that indices below are 1-based
+  QueueHistory.resize(trimSnapshot.QueueIndex);
+
+  // find the highest indices of values histories used until the trim,
+  // positions only grow so they're the ones at the trim
+  vector<szt> biggestIndex;
+  FindHistoryIndices(trimSnapshot.ChangesIndex, biggestIndex);
+  // trim all values histories beyond that index
+  for (szt i = 0; i < ValuesHistories.size(); ++i) {
+    if (ValuesHistories[i].size() > biggestIndex[i]) {
+      ValuesHistories[i].resize(biggestIndex[i]);
+      if (i < LastValues.size()) {
+        LastValues[i].reset();
       }
     }
-    AssetsHistory.resize(maxAssetStateIndex);
+  }
+  ValuesChanges.Resize(trimSnapshot.ChangesIndex);
+  ValuesKeyframes.resize(min(ValuesKeyframes.size(),
+                             ValuesChanges.size() / SESSION_KEYFRAME));
+
+  // find the biggest index of asset changes and trim the rest
+  szt maxAssetStateIndex = 0;
+  for (const Snapshot& snap : Snapshots) {
+    if (snap.AssetsIndex > maxAssetStateIndex) {
+      maxAssetStateIndex = snap.AssetsIndex;
+    }
+  }
+  AssetsHistory.resize(maxAssetStateIndex);
 
-    // remove unused bookmarks
-    auto it = Bookmarks.begin();
-    while (it != Bookmarks.end()) {
-      if (it->first >= trimSnapshot.QueueIndex) {
-        Bookmarks.erase(it++);
-      } else {
-        it++;
-      }
+  // remove unused bookmarks
+  auto it = Bookmarks.begin();
+  while (it != Bookmarks.end()) {
+    if (it->first >= trimSnapshot.QueueIndex) {
+      Bookmarks.erase(it++);
+    } else {
+      it++;
     }
   }
 }
 
 void Session::Reset()
 {
+  Symbols.Clear();
   UserValues.clear();
   AssetStates.clear();
   Snapshots.clear();
@@ -349,8 +443,21 @@ void Session::Reset()
   AssetsHistory.clear();
   ValuesHistories.clear();
   ValuesHistoryNames.clear();
+  ValuesHistoryIndex.clear();
   ValuesChanges.clear();
+  ValuesKeyframes.clear();
   Bookmarks.clear();
+  LastValues.clear();
+  ListedValues.clear();
+  ValuesListed.clear();
+  ReorderedValues.clear();
+  LoadedSnapshot = NO_SNAPSHOT;
+  BookmarksChanged = false;
+  Journal.Reset();
+  // nothing points into them anymore
+  HistoryTexts.Clear();
+  SaveData.clear();
+  ClearVerbs();
   // create the zeroth step so we can go back in history to the start
   Snapshots.push_back(Snapshot(0, 0, 0));
   CurrentSnapshot = 1;
@@ -370,9 +477,12 @@ bool Session::CreateSnapshot()
   Snapshot newSnapshot = Snapshots.back();
 
   // record queue
-  QueueHistory.push_back(GetQueueValuesText());
+  QueueHistory.push_back(HistoryTexts.Add(GetQueueValuesText()));
   newSnapshot.QueueIndex = QueueHistory.size();
-  QueueNoun->Dirty = false;
+  if (QueueNoun->Dirty) {
+    QueueNoun->Dirty = false;
+    TouchValues(Symbols.Find(QUEUE));
+  }
 
   // record active assets
   if (AssetsChanged) {
@@ -383,8 +493,9 @@ bool Session::CreateSnapshot()
       newSnapshot.AssetsIndex = 0;
     } else {
       // only push new history if last asset was empty or different from new
-      if (newSnapshot.AssetsIndex == 0 || AssetsHistory.back() != text) {
-        AssetsHistory.push_back(text);
+      if (newSnapshot.AssetsIndex == 0
+          || HistoryTexts.Get(AssetsHistory.back()) != text) {
+        AssetsHistory.push_back(HistoryTexts.Add(text));
       }
       newSnapshot.AssetsIndex = AssetsHistory.size();
     }
@@ -395,38 +506,55 @@ bool Session::CreateSnapshot()
     ValuesChanged = false;
     bool valuedAdded = false;
 
-    for (auto& valuePair : UserValues) {
-      Properties& newValue = valuePair.second;
-      const string& valueName = valuePair.first;
-      if (newValue.Dirty) {
-        newValue.Dirty = false;
-      } else {
-        // value hasn't changed
-        continue;
+    // only the values written to since the last snapshot can be dirty,
+    // histories are added in the order of the names as they always were
+    vector<uint> changed;
+    for (const uint symbol : ListedValues) {
+      ValuesListed[symbol] = false;
+      const Properties* values = FindUserValues(symbol);
+      if (values && values->Dirty) {
+        changed.push_back(symbol);
       }
-      // if it's not already in the map add the history and the map entry
-      const auto it = ValuesHistoryNames.find(valueName);
-      if (it == ValuesHistoryNames.end()) {
+    }
+    ListedValues.clear();
+    Symbols.SortByName(changed);
+
+    for (const uint symbol : changed) {
+      Properties& newValue = *UserValues[symbol];
+      newValue.Dirty = false;
+      TouchValues(symbol);
+      // if it doesn't have a history yet add the history and the index
+      cszt historyIndex = symbol < ValuesHistoryIndex.size() ?
+                          ValuesHistoryIndex[symbol] : 0;
+      if (!historyIndex) {
         // create a new history to hold the values
         cszt historyI = ValuesHistories.size();
         ValuesHistories.resize(historyI + 1);
-        vector<string>& history = ValuesHistories[historyI];
-        // create a new map entry for this new history
-        ValuesHistoryNames[valueName] = historyI;
+        vector<uint>& history = ValuesHistories[historyI];
+        // remember which noun this new history belongs to
+        SetValuesHistory(symbol, historyI);
         // create the first history value in the history
-        history.push_back(newValue.PrintValues());
-        ValuesChanges.push_back(szt_pair(historyI, history.size()));
+        history.push_back(HistoryTexts.Add(newValue.PrintValues()));
+        SetLastValues(historyI, newValue);
+        ValuesChanges.Add(szt_pair(historyI, history.size()));
         valuedAdded = true;
       } else {
         // add the value to the existing history
-        cszt historyI = it->second;
-        vector<string>& history = ValuesHistories[historyI];
-        const string& oldValue = history.back();
+        cszt historyI = historyIndex - 1;
+        vector<uint>& history = ValuesHistories[historyI];
         // todo: check all former values
-        if (!newValue.IsEquivalent(Properties(oldValue))) {
-          history.push_back(newValue.PrintValues());
-          ValuesChanges.push_back(szt_pair(historyI, history.size()));
+        if (history.empty()
+            || !newValue.IsEquivalent(GetLastValues(historyI))) {
+          history.push_back(HistoryTexts.Add(newValue.PrintValues()));
+          SetLastValues(historyI, newValue);
+          ValuesChanges.Add(szt_pair(historyI, history.size()));
           valuedAdded = true;
+        } else if (newValue.TextValues.GetValues()
+                   != GetLastValues(historyI).TextValues.GetValues()
+                   && find(ReorderedValues.begin(), ReorderedValues.end(),
+                           symbol) == ReorderedValues.end()) {
+          // loading the history would give them back in the old order
+          ReorderedValues.push_back(symbol);
         }
       }
     }
@@ -434,12 +562,16 @@ bool Session::CreateSnapshot()
     // we've added a value, move up the index tracking the newest values
     if (valuedAdded) {
       newSnapshot.ChangesIndex = ValuesChanges.size();
+      AddKeyframes();
     }
   }
 
+  // the values are still in step if they were loaded from the last snapshot
+  const bool loaded = LoadedSnapshot == Snapshots.size() - 1;
   // each move creates a snapshot, because queue is always recorded
   Snapshots.push_back(newSnapshot);
   CurrentSnapshot = Snapshots.size();
+  LoadedSnapshot = loaded ? CurrentSnapshot - 1 : NO_SNAPSHOT;
   return true;
 }
 
@@ -450,14 +582,14 @@ Bookmark& Session::CreateBookmark()
 {
   cszt queueI = CurrentSnapshot > 1 ? CurrentSnapshot - 2 : 0;
   Bookmark& mark = Bookmarks[queueI];
+  BookmarksChanged = true;
   if (mark.Description.empty()) {
     if (queueI < QueueHistory.size()) {
-      const string& queueString = QueueHistory[queueI];
-      string noun, verb;
-      if (ExtractNounVerb(queueString, noun, verb)) {
-        mark.Description += verb;
+      text_view noun, verb;
+      if (ExtractNounVerb(HistoryTexts.Get(QueueHistory[queueI]), noun, verb)) {
+        mark.Description.append(verb.Data, verb.Size);
         mark.Description += ' ';
-        mark.Description += noun;
+        mark.Description.append(noun.Data, noun.Size);
       }
     } else {
       mark.Description = "open book";
@@ -470,7 +602,297 @@ Bookmark& Session::CreateBookmark()
   */
 bool Session::IsUserValues(const string& Noun) const
 {
-  return UserValues.count(Noun);
+  return FindUserValues(Symbols.Find(Noun));
+}
+
+/** @brief Get the user values of the noun by its symbol, creating them
+  * if there aren't any
+  */
+Properties& Session::AddUserValues(const uint Symbol)
+{
+  if (Symbol >= UserValues.size()) {
+    UserValues.resize(Symbol + 1);
+  }
+  if (!UserValues[Symbol]) {
+    UserValues[Symbol].reset(new Properties());
+    TouchValues(Symbol);
+    ListValues(Symbol);
+  }
+  return *UserValues[Symbol];
+}
+
+/** @brief The values of the noun might change, verbs cached with
+  * the old values are no longer valid
+  */
+void Session::TouchValues(const uint Symbol)
+{
+  if (Symbol == NO_SYMBOL) {
+    return;
+  }
+  if (Symbol >= ValuesVersions.size()) {
+    ValuesVersions.resize(Symbol + 1, 0);
+  }
+  ++ValuesVersions[Symbol];
+}
+
+/** @brief The values of the noun are about to be written to, the next
+  * snapshot needs to check if they changed
+  */
+void Session::ChangeValues(const uint Symbol)
+{
+  TouchValues(Symbol);
+  ListValues(Symbol);
+  ValuesChanged = true;
+}
+
+/** @brief Remember the noun so the snapshot only looks at the values that
+  * could be dirty instead of all of them
+  */
+void Session::ListValues(const uint Symbol)
+{
+  if (Symbol == NO_SYMBOL) {
+    return;
+  }
+  if (Symbol >= ValuesListed.size()) {
+    ValuesListed.resize(Symbol + 1, false);
+  }
+  if (!ValuesListed[Symbol]) {
+    ValuesListed[Symbol] = true;
+    ListedValues.push_back(Symbol);
+  }
+}
+
+/** @brief Get the values last recorded in the history, only parsed from
+  * the history text if they haven't been kept since it was loaded or trimmed
+  */
+const Properties& Session::GetLastValues(cszt HistoryIndex)
+{
+  if (HistoryIndex >= LastValues.size()) {
+    LastValues.resize(HistoryIndex + 1);
+  }
+  std::unique_ptr<Properties>& last = LastValues[HistoryIndex];
+  if (!last) {
+    const uint value = ValuesHistories[HistoryIndex].back();
+    last.reset(new Properties(HistoryTexts.Get(value)));
+  }
+  return *last;
+}
+
+/** @brief Keep the values just recorded in the history for comparing
+  */
+void Session::SetLastValues(cszt HistoryIndex,
+                            const Properties& Values)
+{
+  if (HistoryIndex >= LastValues.size()) {
+    LastValues.resize(HistoryIndex + 1);
+  }
+  std::unique_ptr<Properties>& last = LastValues[HistoryIndex];
+  if (last) {
+    *last = Values;
+  } else {
+    last.reset(new Properties(Values));
+  }
+}
+
+/** @brief Find the position in every history after the first ChangesIndex
+  * changes, starting from the closest keyframe before it
+  * \return 1-based positions by history, 0 if the book values are used
+  */
+void Session::FindHistoryIndices(cszt ChangesIndex,
+                                 vector<szt>& Indices) const
+{
+  Indices.assign(ValuesHistories.size(), 0);
+  szt start = 0;
+  cszt keyframeI = min(ChangesIndex / SESSION_KEYFRAME,
+                       ValuesKeyframes.size());
+  if (keyframeI) {
+    const vector<uint>& keyframe = ValuesKeyframes[keyframeI - 1];
+    // histories created after the keyframe start at 0
+    copy(keyframe.begin(), keyframe.end(), Indices.begin());
+    start = keyframeI * SESSION_KEYFRAME;
+  }
+  vector<szt_pair> changes;
+  ValuesChanges.Read(start, ChangesIndex, changes);
+  for (cszt_pair& change : changes) {
+    Indices[change.X] = change.Y;
+  }
+}
+
+/** @brief Find the position of a single history after the changes,
+  * looking back no further than the keyframe before them
+  * \return 1-based index, 0 if the history had no values yet
+  */
+szt Session::FindHistoryIndex(cszt ChangesIndex, cszt History) const
+{
+  cszt keyframeI = min(ChangesIndex / SESSION_KEYFRAME,
+                       ValuesKeyframes.size());
+  vector<szt_pair> changes;
+  ValuesChanges.Read(keyframeI * SESSION_KEYFRAME, ChangesIndex, changes);
+  for (szt i = changes.size(); i > 0; --i) {
+    cszt_pair& change = changes[i - 1];
+    if (change.X == History) {
+      return change.Y;
+    }
+  }
+  if (keyframeI) {
+    const vector<uint>& keyframe = ValuesKeyframes[keyframeI - 1];
+    if (History < keyframe.size()) {
+      return keyframe[History];
+    }
+  }
+  return 0;
+}
+
+/** @brief Add the keyframes for the changes recorded since the last one
+  */
+void Session::AddKeyframes()
+{
+  vector<szt> indices;
+  while ((ValuesKeyframes.size() + 1) * SESSION_KEYFRAME
+         <= ValuesChanges.size()) {
+    FindHistoryIndices((ValuesKeyframes.size() + 1) * SESSION_KEYFRAME,
+                       indices);
+    ValuesKeyframes.push_back(vector<uint>(indices.begin(), indices.end()));
+  }
+}
+
+/** @brief Get the verbs listed for the noun if nothing they read has
+  * changed since
+  * \return NULL if they need to be listed again
+  */
+const Properties* Session::FindVerbs(const uint Symbol) const
+{
+  if (Symbol >= VerbsCache.size() || !VerbsCache[Symbol].Valid) {
+    return NULL;
+  }
+  const CachedVerbs& cached = VerbsCache[Symbol];
+  for (szt i = 0, fSz = cached.Reads.size(); i < fSz; ++i) {
+    const uint symbol = cached.Reads[i];
+    const uint version = symbol < ValuesVersions.size() ?
+                         ValuesVersions[symbol] : 0;
+    const Properties* values = FindUserValues(symbol);
+    if (version != cached.Versions[i] || (values && values->Dirty)) {
+      return NULL;
+    }
+  }
+  return &cached.Verbs;
+}
+
+/** @brief Keep the verbs listed for the noun together with the nouns
+  * their conditions read, values that changed this turn are still in flux
+  * so those verbs aren't kept
+  */
+void Session::StoreVerbs(const uint Symbol,
+                         const Properties& Verbs,
+                         const vector<uint>& Reads)
+{
+  if (Symbol == NO_SYMBOL) {
+    return;
+  }
+  for (const uint symbol : Reads) {
+    const Properties* values = FindUserValues(symbol);
+    if (values && values->Dirty) {
+      return;
+    }
+  }
+  if (Symbol >= VerbsCache.size()) {
+    VerbsCache.resize(Symbol + 1);
+  }
+  CachedVerbs& cached = VerbsCache[Symbol];
+  cached.Valid = true;
+  cached.Verbs = Verbs;
+  cached.Reads = Reads;
+  cached.Versions.clear();
+  for (const uint symbol : Reads) {
+    cached.Versions.push_back(symbol < ValuesVersions.size() ?
+                              ValuesVersions[symbol] : 0);
+  }
+}
+
+void Session::ClearVerbs()
+{
+  VerbsCache.clear();
+}
+
+/** @brief Are these the values of one of the system nouns
+  */
+bool Session::IsSystemValues(const Properties* Values) const
+{
+  for (const Properties* systemNoun : SystemNouns) {
+    if (Values == systemNoun) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief Play the assets recorded in the history and stop the rest,
+  * only the assets whose state differs are changed
+  */
+void Session::SetAssetStates(szt AssetsIndex)
+{
+  vector<uint> playing;
+  // index 0 means all assets are off
+  if (AssetsIndex > 0) {
+    const text_view assets = HistoryTexts.Get(AssetsHistory[--AssetsIndex]);
+    szt lastPos = 0;
+    szt pos = FindCharacter(assets, '\n', lastPos);
+
+    while (pos != string::npos && pos > lastPos) {
+      playing.push_back(Symbols.Add(CutString(assets, lastPos, pos)));
+      lastPos = ++pos;
+      pos = FindCharacter(assets, '\n', lastPos);
+    }
+    if (lastPos < assets.size()) {
+      // last value doesn't have a \n at the end
+      playing.push_back(Symbols.Add(CutString(assets, lastPos)));
+    }
+  }
+
+  for (szt i = 0, fSz = AssetStates.size(); i < fSz; ++i) {
+    if (AssetStates[i].Playing
+        && find(playing.begin(), playing.end(), i) == playing.end()) {
+      AssetStates[i].Playing = false;
+    }
+  }
+  for (const uint symbol : playing) {
+    if (symbol >= AssetStates.size()) {
+      AssetStates.resize(symbol + 1);
+    }
+    AssetStates[symbol].Playing = true;
+  }
+}
+
+/** @brief Turn the asset on or off
+  * \return false if nothing needed doing
+  */
+bool Session::SetAssetState(const string& AssetName,
+                            const bool Playing)
+{
+  const uint symbol = Symbols.Add(AssetName);
+  if (symbol >= AssetStates.size()) {
+    AssetStates.resize(symbol + 1);
+  }
+  if (AssetStates[symbol].Playing != Playing) {
+    AssetStates[symbol].Playing = Playing;
+    return true;
+  }
+  return false;
+}
+
+/** @brief Remember the history of values that belongs to the noun
+  */
+void Session::SetValuesHistory(const uint Symbol,
+                               cszt Index)
+{
+  if (Index >= ValuesHistoryNames.size()) {
+    ValuesHistoryNames.resize(Index + 1, NO_SYMBOL);
+  }
+  ValuesHistoryNames[Index] = Symbol;
+  if (Symbol >= ValuesHistoryIndex.size()) {
+    ValuesHistoryIndex.resize(Symbol + 1, 0);
+  }
+  ValuesHistoryIndex[Symbol] = Index + 1;
 }
 
 /** @brief Check for presence in user values
@@ -480,9 +902,9 @@ bool Session::IsUserValues(const string& Noun) const
 bool Session::GetUserInteger(const string& Noun,
                              Properties& ReturnValue) const
 {
-  map<string, Properties>::const_iterator it = UserValues.find(Noun);
-  if (it != UserValues.end()) {
-    ReturnValue.IntValue += it->second.IntValue;
+  const Properties* values = FindUserValues(Symbols.Find(Noun));
+  if (values) {
+    ReturnValue.IntValue += values->IntValue;
     return true;
   }
   return false;
@@ -495,9 +917,9 @@ bool Session::GetUserInteger(const string& Noun,
 bool Session::GetUserTextValues(const string& Noun,
                                 Properties& ReturnValue) const
 {
-  map<string, Properties>::const_iterator it = UserValues.find(Noun);
-  if (it != UserValues.end()) {
-    ReturnValue.AddValues(it->second);
+  const Properties* values = FindUserValues(Symbols.Find(Noun));
+  if (values) {
+    ReturnValue.AddValues(*values);
     return true;
   }
   return false;
@@ -4,8 +4,18 @@
 #include "main.h"
 #include "properties.h"
 #include "tokens.h"
-
-class File;
+#include "symboltable.h"
+#include "sessionjournal.h"
+#include "historytext.h"
+#include "changelist.h"
+#include "file.h"
+#include <memory>
+#include <deque>
+
+const szt NO_SNAPSHOT = (szt)-1;
+// how many value changes apart the history keyframes are, a block of the
+// change list so reading from a keyframe doesn't skip through a block
+cszt SESSION_KEYFRAME = CHANGELIST_BLOCK;
 
 struct Snapshot {
   Snapshot() { };
@@ -28,32 +38,67 @@ struct AssetState {
   bool Playing = false;
 };
 
+/** @brief Verbs of a noun that passed their conditions and the nouns
+  * the conditions read, with the version of their values at the time
+  */
+struct CachedVerbs {
+  CachedVerbs() { };
+  bool Valid = false;
+  Properties Verbs;
+  vector<uint> Reads;
+  vector<uint> Versions;
+};
+
 class Session
 {
 public:
   Session() { };
   ~Session() { };
 
-  bool Load();
+  bool Load(WriteQueue& Writer);
+  bool Save(const string& SavePath, WriteQueue& Writer);
   void Reset();
-  const string GetSessionText() const;
 
   bool IsUserValues(const string& Noun) const;
+  inline Properties* FindUserValues(const uint Symbol) const;
+  Properties& AddUserValues(const uint Symbol);
+  inline bool GetAssetState(const string& AssetName) const;
+  bool SetAssetState(const string& AssetName, const bool Playing);
   bool GetUserInteger(const string& Noun, Properties& ReturnValue) const;
   bool GetUserTextValues(const string& Noun, Properties& ReturnValue) const;
 
   inline const Properties& GetSystemValues(systemNoun Noun);
   inline void AddQueueValue(const string& Value);
 
+  void TouchValues(const uint Symbol);
+  void ChangeValues(const uint Symbol);
+  const Properties* FindVerbs(const uint Symbol) const;
+  void StoreVerbs(const uint Symbol, const Properties& Verbs,
+                  const vector<uint>& Reads);
+  void ClearVerbs();
+
   Bookmark& CreateBookmark();
   bool CreateSnapshot();
   bool LoadSnapshot(cszt Index);
+  bool StepSnapshot(cszt Index);
   void Trim();
+  void Branch();
 
 private:
+  void LoadText(File& Save);
   string GetUserValuesText() const;
   string GetAssetStatesText() const;
   string GetQueueValuesText() const;
+  void SetValuesHistory(const uint Symbol, cszt Index);
+  void ListValues(const uint Symbol);
+  const Properties& GetLastValues(cszt HistoryIndex);
+  void SetLastValues(cszt HistoryIndex, const Properties& Values);
+  void FindHistoryIndices(cszt ChangesIndex, vector<szt>& Indices) const;
+  szt FindHistoryIndex(cszt ChangesIndex, cszt History) const;
+  void AddKeyframes();
+  bool IsSystemValues(const Properties* Values) const;
+  void SetAssetStates(szt AssetsIndex);
+  void TrimHistories(cszt SnapshotCount);
 
 
 public:
@@ -63,29 +108,79 @@ public:
 
   bool ValuesChanged = true;
   bool AssetsChanged = true;
+  bool BookmarksChanged = false;
 
   szt CurrentSnapshot = 0;
 
 private:
-  map<string, Properties> UserValues;
-  map<string, AssetState> AssetStates;
+  // names of the nouns and assets used in the session, values are kept
+  // by their symbol in this table
+  SymbolTable Symbols;
+  vector<std::unique_ptr<Properties>> UserValues;
+  vector<AssetState> AssetStates;
   // for quick access
   const Properties* SystemNouns[SYSTEM_NOUN_MAX];
   Properties* QueueNoun;
 
   vector<Snapshot> Snapshots;
-  vector<string> QueueHistory;
-  vector<string> AssetsHistory;
+  // histories loaded from the session file reference their texts in the
+  // mapped file, they're only read when needed, a branch also maps the
+  // files of the sessions it branched from
+  std::deque<MappedFile> SaveData;
+  HistoryText HistoryTexts;
+  vector<uint> QueueHistory;
+  vector<uint> AssetsHistory;
   // this keeps track of all the values individually
-  vector<vector<string>> ValuesHistories;
-  map<string, szt> ValuesHistoryNames;
-  vector<szt_pair> ValuesChanges;
+  vector<vector<uint>> ValuesHistories;
+  vector<uint> ValuesHistoryNames; // symbol of each history
+  vector<szt> ValuesHistoryIndex; // history + 1 by symbol, 0 if none
+  ChangeList ValuesChanges;
+  // positions in every history after each SESSION_KEYFRAME changes
+  // so seeking doesn't have to replay the changes from the start
+  vector<vector<uint>> ValuesKeyframes;
   map<szt, Bookmark> Bookmarks;
+  // last value of each history as it was recorded, parsed on demand
+  vector<std::unique_ptr<Properties>> LastValues;
+  // nouns whose values may have been written to since the last snapshot
+  vector<uint> ListedValues;
+  vector<bool> ValuesListed; // by symbol
+  // values kept over their history because they only differ in the order
+  vector<uint> ReorderedValues;
+  // snapshot the values in memory were loaded from, apart from the ones
+  // listed since, so undo and redo only need to replace what changed
+  szt LoadedSnapshot = NO_SNAPSHOT;
+
+  // bumped by symbol every time the values might have changed
+  vector<uint> ValuesVersions;
+  // verbs listed for the nouns by symbol, valid until the values they read
+  // are changed
+  vector<CachedVerbs> VerbsCache;
+
+  // what of the histories is already in the session file
+  SessionJournal Journal;
 
   friend class Book;
   friend class StoryQuery;
+  friend class SessionJournal;
 };
 
+/** @brief Get the user values of the noun by its symbol
+  * \return NULL if there are no user values
+  */
+Properties* Session::FindUserValues(const uint Symbol) const
+{
+  if (Symbol < UserValues.size()) {
+    return UserValues[Symbol].get();
+  }
+  return NULL;
+}
+
+bool Session::GetAssetState(const string& AssetName) const
+{
+  const uint symbol = Symbols.Find(AssetName);
+  return symbol < AssetStates.size() && AssetStates[symbol].Playing;
+}
+
 void Session::AddQueueValue(const string& Value)
 {
   QueueNoun->AddValue(Value);
@@ -0,0 +1,149 @@
+#include "sessioncatalog.h"
+#include "disk.h"
+#include "library.h"
+#include "writequeue.h"
+#include <algorithm>
+
+// map files starting with this have a line of details after every name,
+// older ones are just pairs of filename and name
+const string CATALOG_TITLE = "Session catalog:";
+
+/** @brief Read the turns, time saved and bookmark from the details line
+  */
+static void ReadEntryDetails(const string& Details, SessionEntry& Entry)
+{
+  Entry.Turns = IntoSizeT(Details);
+  szt pos = Details.find(' ');
+  if (pos == string::npos) {
+    return;
+  }
+  Entry.Modified = ReadInteger(text_view(Details.data() + pos + 1,
+                                         Details.size() - pos - 1));
+  pos = Details.find(' ', pos + 1);
+  if (pos != string::npos) {
+    Entry.LastBookmark = Details.substr(pos + 1);
+  }
+}
+
+/** @brief List the session files in the folder and read the names of the
+  * ones that still exist from the map file
+  */
+void SessionCatalog::Load(const string& aPath)
+{
+  Path = aPath;
+  Entries.clear();
+  Filenames = Library::ListFiles(Path, SESSION_EXT, true);
+  if (Filenames.empty()) {
+    return;
+  }
+  sort(Filenames.begin(), Filenames.end());
+
+  const string& mapFilename = Path + SLASH + SESSION_MAP;
+  if (!Disk::Exists(mapFilename)) {
+    return;
+  }
+  File mapFile;
+  mapFile.Read(mapFilename);
+  string line;
+  if (!mapFile.GetLine(line)) {
+    return;
+  }
+  const bool details = line == CATALOG_TITLE;
+  if (details && !mapFile.GetLine(line)) {
+    return;
+  }
+  SessionEntry entry;
+  entry.Filename = line;
+  while (mapFile.GetLine(entry.Name)) {
+    if (details && mapFile.GetLine(line)) {
+      ReadEntryDetails(line, entry);
+    }
+    if (binary_search(Filenames.begin(), Filenames.end(), entry.Filename)) {
+      Entries.push_back(entry);
+    }
+    entry = SessionEntry();
+    if (!mapFile.GetLine(entry.Filename)) {
+      break;
+    }
+  }
+}
+
+/** @brief Queue the map file to be written with all the entries
+  */
+void SessionCatalog::Save(WriteQueue& Writer) const
+{
+  string text = CATALOG_TITLE;
+  text += '\n';
+  for (const SessionEntry& entry : Entries) {
+    text += entry.Filename;
+    text += '\n';
+    text += entry.Name;
+    text += '\n';
+    text += IntoString(entry.Turns);
+    text += ' ';
+    text += IntoString(entry.Modified);
+    if (!entry.LastBookmark.empty()) {
+      text += ' ';
+      text += entry.LastBookmark;
+    }
+    text += '\n';
+  }
+  Writer.Replace(Path + SLASH + SESSION_MAP, text);
+}
+
+/** @brief Replace the entry of the same file and make it the first one,
+  * the session last saved is the one continued
+  */
+void SessionCatalog::Update(const SessionEntry& Entry)
+{
+  for (szt i = 0, fSz = Entries.size(); i < fSz; ++i) {
+    if (Entries[i].Filename == Entry.Filename) {
+      Entries.erase(Entries.begin() + i);
+      break;
+    }
+  }
+  Entries.insert(Entries.begin(), Entry);
+  // the details are a single line in the map file
+  replace(Entries.front().LastBookmark.begin(),
+          Entries.front().LastBookmark.end(), '\n', ' ');
+
+  const auto it = lower_bound(Filenames.begin(), Filenames.end(),
+                              Entry.Filename);
+  if (it == Filenames.end() || *it != Entry.Filename) {
+    Filenames.insert(it, Entry.Filename);
+  }
+}
+
+const SessionEntry* SessionCatalog::Find(const string& Name) const
+{
+  for (const SessionEntry& entry : Entries) {
+    if (entry.Name == Name) {
+      return &entry;
+    }
+  }
+  return NULL;
+}
+
+/** @brief Lowest numbered filename no session file uses
+  */
+const string SessionCatalog::GetFreeFilename() const
+{
+  szt i = 1;
+  while (binary_search(Filenames.begin(), Filenames.end(), IntoString(i))) {
+    ++i;
+  }
+  return IntoString(i);
+}
+
+/** @brief Mangle the name so no other session has it
+  * \return false if the name was already unique
+  */
+bool SessionCatalog::MakeNameUnique(string& Name) const
+{
+  const string originalName = Name;
+  szt i = 1;
+  while (Find(Name)) {
+    Name = originalName + IntoString(++i);
+  }
+  return i > 1;
+}
@@ -0,0 +1,49 @@
+#ifndef SESSIONCATALOG_H
+#define SESSIONCATALOG_H
+
+#include "main.h"
+
+class WriteQueue;
+
+/** @brief What the menus show about a session without opening its file
+  */
+struct SessionEntry {
+  string Filename;
+  string Name;
+  szt Turns = 0;
+  lint Modified = 0;
+  string LastBookmark;
+};
+
+/** @brief Sessions of a book, read from its folder and map file once and
+  * kept up to date as sessions are saved
+  *
+  * Entries are in the order they were last saved in, the first one is the
+  * session to continue. Filenames of every session file in the folder are
+  * kept sorted, named or not, so a free filename is found without asking
+  * the disk. The map file is written whole after every change.
+  */
+class SessionCatalog
+{
+public:
+  SessionCatalog() { };
+  ~SessionCatalog() { };
+
+  void Load(const string& aPath);
+  void Save(WriteQueue& Writer) const;
+  void Update(const SessionEntry& Entry);
+  const SessionEntry* Find(const string& Name) const;
+  const string GetFreeFilename() const;
+  bool MakeNameUnique(string& Name) const;
+
+
+public:
+  vector<SessionEntry> Entries;
+
+private:
+  string Path;
+  // sorted
+  vector<string> Filenames;
+};
+
+#endif // SESSIONCATALOG_H
@@ -0,0 +1,650 @@
+#include "sessionjournal.h"
+#include "session.h"
+#include "file.h"
+#include "binarydata.h"
+#include "writequeue.h"
+
+const char JOURNAL_MAGIC[] = "LETHESJ";
+const uint32_t JOURNAL_VERSION = 1;
+// magic, version
+cszt JOURNAL_HEADER_SIZE = 8 + 4;
+// type, size and checksum in front of every record
+cszt JOURNAL_RECORD_SIZE = 1 + 4 + 4;
+// records appended before the whole file is written again
+cszt JOURNAL_COMPACT = 256;
+// branches of branches loaded before giving up, in case they go in circles
+cszt JOURNAL_MAX_PARENTS = 256;
+
+const uchar RECORD_NAMES = 1;
+const uchar RECORD_TURNS = 2;
+const uchar RECORD_BOOKMARKS = 3;
+const uchar RECORD_PARENT = 4;
+const uchar RECORD_KEYFRAMES = 5;
+
+inline uint32_t Checksum(const char* Data, cszt Size)
+{
+  uint64_t hash = FNV_OFFSET;
+  HashBytes(hash, Data, Size);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void PutRecord(string& Out, const uchar Type, const string& Payload)
+{
+  Out += (char)Type;
+  PutU32(Out, Payload.size());
+  PutU32(Out, Checksum(Payload.data(), Payload.size()));
+  Out += Payload;
+}
+
+/** @brief Check the file starts like a journal, older sessions are text
+  */
+bool SessionJournal::IsJournal(const string& Filename)
+{
+  MappedFile journal;
+  return journal.Map(Filename) && journal.Size >= JOURNAL_HEADER_SIZE
+         && string(journal.Data, 7) == JOURNAL_MAGIC;
+}
+
+/** @brief Fill the session histories with all the records that are whole,
+  * a damaged end gets dropped with the next save
+  * the file stays mapped and the histories point into it
+  * \return false if the file can't be read as a journal
+  */
+bool SessionJournal::Load(const string& Filename,
+                          Session& MySession)
+{
+  Reset();
+  MySession.SaveData.clear();
+  MySession.HistoryTexts.Clear();
+  if (!Read(Filename, MySession, 0)) {
+    return false;
+  }
+  Written(MySession);
+  return true;
+}
+
+/** @brief Add the records of the file to the histories, a branch reads the
+  * files it branched from first
+  */
+bool SessionJournal::Read(const string& Filename,
+                          Session& MySession,
+                          cszt Depth)
+{
+  MySession.SaveData.emplace_back();
+  MappedFile& journal = MySession.SaveData.back();
+  if (!journal.Map(Filename) || journal.Size < JOURNAL_HEADER_SIZE
+      || string(journal.Data, 7) != JOURNAL_MAGIC) {
+    return false;
+  }
+  BinaryReader header(journal.Data, journal.Size, 8);
+  const uint32_t version = header.U32();
+  if (!version || version > JOURNAL_VERSION) {
+    LOG(Filename + " - unknown session journal version");
+    return false;
+  }
+  MySession.HistoryTexts.AddSegment(journal.Data, journal.Size);
+
+  szt pos = JOURNAL_HEADER_SIZE;
+  while (journal.Size - pos >= JOURNAL_RECORD_SIZE) {
+    BinaryReader record(journal.Data, journal.Size, pos);
+    const uchar type = record.U8();
+    cszt size = record.U32();
+    const uint32_t checksum = record.U32();
+    if (size > journal.Size - record.Pos
+        || Checksum(journal.Data + record.Pos, size) != checksum) {
+      break;
+    }
+    // the record can't read past its own end
+    BinaryReader payload(journal.Data, record.Pos + size, record.Pos);
+    bool valid = false;
+    if (type == RECORD_PARENT) {
+      // a branch can't be loaded without what it branched from
+      if (pos != JOURNAL_HEADER_SIZE
+          || !GetParent(payload, Filename, MySession, Depth)) {
+        return false;
+      }
+      valid = true;
+    } else if (type == RECORD_NAMES) {
+      valid = GetNames(payload, MySession);
+    } else if (type == RECORD_TURNS) {
+      valid = GetTurns(payload, MySession);
+    } else if (type == RECORD_BOOKMARKS) {
+      valid = GetBookmarks(payload, MySession);
+    } else if (type == RECORD_KEYFRAMES) {
+      valid = GetKeyframes(payload, MySession);
+    }
+    if (!valid) {
+      break;
+    }
+    pos = payload.Size;
+    ++Records;
+  }
+
+  if (pos < journal.Size) {
+    LOG(Filename + " - damaged session journal, loaded the turns before it");
+    // so the next save writes the file whole instead of appending
+    JournalFilename.clear();
+  } else {
+    JournalFilename = Filename;
+  }
+  return true;
+}
+
+/** @brief Append what changed in the session since the last save, or write
+  * it whole if the file can't be appended to, the records are built here
+  * and written by the writer in the background
+  */
+bool SessionJournal::Save(const string& Filename,
+                          const Session& MySession,
+                          WriteQueue& Writer)
+{
+  if (Writer.TakeFailure()) {
+    // whatever made it to the disk is dropped by writing it whole
+    JournalFilename.clear();
+  }
+  // the history was trimmed or the records piled up
+  if (Filename != JournalFilename || Records >= JOURNAL_COMPACT
+      || QueueCount > MySession.QueueHistory.size()
+      || AssetsCount > MySession.AssetsHistory.size()
+      || HistoriesCount > MySession.ValuesHistories.size()
+      || ChangesCount > MySession.ValuesChanges.size()
+      || SnapshotsCount > MySession.Snapshots.size()
+      || KeyframesCount > MySession.ValuesKeyframes.size()) {
+    return Compact(Filename, MySession, Writer);
+  }
+
+  string records;
+  string payload;
+  szt count = 0;
+  if (Name != MySession.Name || BookName != MySession.BookName) {
+    PutNames(payload, MySession);
+    PutRecord(records, RECORD_NAMES, payload);
+    ++count;
+  }
+  if (HasTurns(MySession)) {
+    payload.clear();
+    PutTurns(payload, MySession);
+    PutRecord(records, RECORD_TURNS, payload);
+    ++count;
+  }
+  // after the turns as they're for the changes in them
+  if (KeyframesCount < MySession.ValuesKeyframes.size()) {
+    payload.clear();
+    PutKeyframes(payload, MySession);
+    PutRecord(records, RECORD_KEYFRAMES, payload);
+    ++count;
+  }
+  if (MySession.BookmarksChanged) {
+    payload.clear();
+    PutBookmarks(payload, MySession);
+    PutRecord(records, RECORD_BOOKMARKS, payload);
+    ++count;
+  }
+  if (records.empty()) {
+    return true;
+  }
+
+  Writer.Append(Filename, records);
+  Written(MySession);
+  Records += count;
+  return true;
+}
+
+/** @brief Forget what was written, the next save writes the whole session
+  */
+void SessionJournal::Reset()
+{
+  Parent = JournalParent();
+  Rewind();
+}
+
+/** @brief The session continues the histories saved in the file, the next
+  * save writes a branch of it with only what follows
+  */
+void SessionJournal::Fork(const string& ParentFilename,
+                          const Session& MySession)
+{
+  Parent.Filename = ParentFilename;
+  Parent.QueueCount = MySession.QueueHistory.size();
+  Parent.AssetsCount = MySession.AssetsHistory.size();
+  Parent.HistoriesCount = MySession.ValuesHistories.size();
+  Parent.ChangesCount = MySession.ValuesChanges.size();
+  Parent.SnapshotsCount = MySession.Snapshots.size();
+  Parent.KeyframesCount = MySession.ValuesKeyframes.size();
+  Parent.Check = GetCheck(MySession);
+  Rewind();
+}
+
+/** @brief Forget what was written apart from what's in the parent
+  */
+void SessionJournal::Rewind()
+{
+  JournalFilename.clear();
+  Name.clear();
+  BookName.clear();
+  QueueCount = Parent.QueueCount;
+  AssetsCount = Parent.AssetsCount;
+  HistoriesCount = Parent.HistoriesCount;
+  ChangesCount = Parent.ChangesCount;
+  SnapshotsCount = Parent.SnapshotsCount;
+  KeyframesCount = Parent.KeyframesCount;
+  Records = 0;
+}
+
+/** @brief Write the whole session next to the file and move it over it
+  * so the old file stays intact until the new one is complete, a branch
+  * only writes what follows its parent
+  */
+bool SessionJournal::Compact(const string& Filename,
+                             const Session& MySession,
+                             WriteQueue& Writer)
+{
+  Rewind();
+  string journal;
+  journal.append(JOURNAL_MAGIC, 8);
+  PutU32(journal, JOURNAL_VERSION);
+  string payload;
+  if (!Parent.Filename.empty()) {
+    PutParent(payload);
+    PutRecord(journal, RECORD_PARENT, payload);
+    payload.clear();
+  }
+  PutNames(payload, MySession);
+  PutRecord(journal, RECORD_NAMES, payload);
+  payload.clear();
+  PutTurns(payload, MySession);
+  PutRecord(journal, RECORD_TURNS, payload);
+  if (KeyframesCount < MySession.ValuesKeyframes.size()) {
+    payload.clear();
+    PutKeyframes(payload, MySession);
+    PutRecord(journal, RECORD_KEYFRAMES, payload);
+  }
+  if (!MySession.Bookmarks.empty()) {
+    payload.clear();
+    PutBookmarks(payload, MySession);
+    PutRecord(journal, RECORD_BOOKMARKS, payload);
+  }
+
+  Writer.Replace(Filename, journal);
+  Written(MySession);
+  JournalFilename = Filename;
+  return true;
+}
+
+/** @brief Are there turns played that aren't in the file yet
+  */
+bool SessionJournal::HasTurns(const Session& MySession) const
+{
+  return QueueCount != MySession.QueueHistory.size()
+         || AssetsCount != MySession.AssetsHistory.size()
+         || HistoriesCount != MySession.ValuesHistories.size()
+         || ChangesCount != MySession.ValuesChanges.size()
+         || SnapshotsCount != MySession.Snapshots.size();
+}
+
+void SessionJournal::PutParent(string& Out) const
+{
+  PutString(Out, Parent.Filename);
+  PutU32(Out, Parent.QueueCount);
+  PutU32(Out, Parent.AssetsCount);
+  PutU32(Out, Parent.HistoriesCount);
+  PutU32(Out, Parent.ChangesCount);
+  PutU32(Out, Parent.SnapshotsCount);
+  PutU32(Out, Parent.Check);
+}
+
+void SessionJournal::PutNames(string& Out, const Session& MySession) const
+{
+  PutString(Out, MySession.Name);
+  PutString(Out, MySession.BookName);
+}
+
+/** @brief Everything added to the histories since the last save, values
+  * are written with the change that added them to their history
+  */
+void SessionJournal::PutTurns(string& Out, const Session& MySession) const
+{
+  PutU32(Out, MySession.QueueHistory.size() - QueueCount);
+  const HistoryText& texts = MySession.HistoryTexts;
+  for (szt i = QueueCount, fSz = MySession.QueueHistory.size(); i < fSz; ++i) {
+    PutString(Out, texts.Get(MySession.QueueHistory[i]));
+  }
+  PutU32(Out, MySession.AssetsHistory.size() - AssetsCount);
+  for (szt i = AssetsCount, fSz = MySession.AssetsHistory.size();
+       i < fSz; ++i) {
+    PutString(Out, texts.Get(MySession.AssetsHistory[i]));
+  }
+  PutU32(Out, MySession.ValuesHistories.size() - HistoriesCount);
+  for (szt i = HistoriesCount, fSz = MySession.ValuesHistories.size();
+       i < fSz; ++i) {
+    const uint symbol = MySession.ValuesHistoryNames[i];
+    // histories without a noun are kept so the indices don't shift
+    PutString(Out, symbol == NO_SYMBOL ? string()
+                   : MySession.Symbols.GetName(symbol));
+  }
+  vector<szt_pair> changes;
+  MySession.ValuesChanges.Read(ChangesCount, MySession.ValuesChanges.size(),
+                               changes);
+  PutU32(Out, changes.size());
+  for (cszt_pair& change : changes) {
+    PutU32(Out, change.X);
+    PutU32(Out, change.Y);
+    const uint value = MySession.ValuesHistories[change.X][change.Y - 1];
+    PutString(Out, texts.Get(value));
+  }
+  PutU32(Out, MySession.Snapshots.size() - SnapshotsCount);
+  for (szt i = SnapshotsCount, fSz = MySession.Snapshots.size();
+       i < fSz; ++i) {
+    const Snapshot& snap = MySession.Snapshots[i];
+    PutU32(Out, snap.QueueIndex);
+    PutU32(Out, snap.AssetsIndex);
+    PutU32(Out, snap.ChangesIndex);
+  }
+}
+
+/** @brief All the bookmarks, they replace the ones in earlier records
+  */
+void SessionJournal::PutBookmarks(string& Out,
+                                  const Session& MySession) const
+{
+  PutU32(Out, MySession.Bookmarks.size());
+  for (const auto& mark : MySession.Bookmarks) {
+    PutU32(Out, mark.first);
+    PutString(Out, mark.second.Description);
+  }
+}
+
+/** @brief The keyframes added since the last save, with where they start
+  * and how far apart they are so ones that don't fit can be left out
+  */
+void SessionJournal::PutKeyframes(string& Out,
+                                  const Session& MySession) const
+{
+  PutU32(Out, SESSION_KEYFRAME);
+  PutU32(Out, KeyframesCount);
+  PutU32(Out, MySession.ValuesKeyframes.size() - KeyframesCount);
+  for (szt i = KeyframesCount, fSz = MySession.ValuesKeyframes.size();
+       i < fSz; ++i) {
+    const vector<uint>& keyframe = MySession.ValuesKeyframes[i];
+    PutU32(Out, keyframe.size());
+    for (const uint position : keyframe) {
+      PutU32(Out, position);
+    }
+  }
+}
+
+/** @brief Load the session the branch continues and cut its histories back
+  * to where the branch started, it may have been played on since
+  */
+bool SessionJournal::GetParent(BinaryReader& Record,
+                               const string& Filename,
+                               Session& MySession,
+                               cszt Depth)
+{
+  JournalParent parent;
+  Record.Str(parent.Filename);
+  parent.QueueCount = Record.U32();
+  parent.AssetsCount = Record.U32();
+  parent.HistoriesCount = Record.U32();
+  parent.ChangesCount = Record.U32();
+  parent.SnapshotsCount = Record.U32();
+  parent.Check = Record.U32();
+  if (Record.Failed || Record.Pos != Record.Size || !parent.SnapshotsCount
+      || parent.Filename.empty()) {
+    return false;
+  }
+  if (Depth >= JOURNAL_MAX_PARENTS) {
+    LOG(Filename + " - too many sessions branched from each other");
+    return false;
+  }
+  cszt slashPos = Filename.find_last_of(SLASH);
+  const string& parentPath = (slashPos == string::npos ? string()
+                              : Filename.substr(0, slashPos + 1))
+                             + parent.Filename + SESSION_EXT;
+  SessionJournal parentJournal;
+  if (!parentJournal.Read(parentPath, MySession, Depth + 1)) {
+    LOG(Filename + " - can't load the session it branched from");
+    return false;
+  }
+  if (MySession.Snapshots.size() < parent.SnapshotsCount
+      || MySession.ValuesHistories.size() < parent.HistoriesCount) {
+    LOG(Filename + " - the session it branched from is missing turns");
+    return false;
+  }
+
+  MySession.TrimHistories(parent.SnapshotsCount);
+  // histories started after the branch only have values after it
+  vector<uint>& names = MySession.ValuesHistoryNames;
+  for (szt i = parent.HistoriesCount, fSz = names.size(); i < fSz; ++i) {
+    if (names[i] != NO_SYMBOL) {
+      MySession.ValuesHistoryIndex[names[i]] = 0;
+    }
+  }
+  MySession.ValuesHistories.resize(parent.HistoriesCount);
+  names.resize(parent.HistoriesCount);
+  parent.KeyframesCount = MySession.ValuesKeyframes.size();
+  // the branch has bookmarks of its own
+  MySession.Bookmarks.clear();
+
+  if (MySession.QueueHistory.size() != parent.QueueCount
+      || MySession.AssetsHistory.size() != parent.AssetsCount
+      || MySession.ValuesChanges.size() != parent.ChangesCount
+      || GetCheck(MySession) != parent.Check) {
+    LOG(Filename + " - the session it branched from has changed");
+    return false;
+  }
+  Parent = parent;
+  return true;
+}
+
+bool SessionJournal::GetNames(BinaryReader& Record, Session& MySession)
+{
+  string name, bookName;
+  Record.Str(name);
+  Record.Str(bookName);
+  if (Record.Failed || Record.Pos != Record.Size) {
+    return false;
+  }
+  MySession.Name = name;
+  MySession.BookName = bookName;
+  return true;
+}
+
+/** @brief Read the whole record before adding any of it to the histories
+  * so a record that doesn't fit them leaves the session as it was
+  */
+bool SessionJournal::GetTurns(BinaryReader& Record, Session& MySession)
+{
+  vector<text_view> queue;
+  vector<text_view> assets;
+  vector<string> names;
+  vector<szt_pair> changes;
+  vector<text_view> values;
+  vector<Snapshot> snapshots;
+
+  // every entry takes at least a byte so counts beyond that are damage
+  szt count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  queue.resize(count);
+  for (text_view& value : queue) {
+    Record.Str(value);
+  }
+  count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  assets.resize(count);
+  for (text_view& value : assets) {
+    Record.Str(value);
+  }
+  count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  names.resize(count);
+  for (string& name : names) {
+    Record.Str(name);
+  }
+  count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  changes.resize(count);
+  values.resize(count);
+  for (szt i = 0; i < count; ++i) {
+    changes[i].X = Record.U32();
+    changes[i].Y = Record.U32();
+    Record.Str(values[i]);
+  }
+  count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  snapshots.resize(count);
+  for (Snapshot& snap : snapshots) {
+    snap.QueueIndex = Record.U32();
+    snap.AssetsIndex = Record.U32();
+    snap.ChangesIndex = Record.U32();
+  }
+  if (Record.Failed || Record.Pos != Record.Size) {
+    return false;
+  }
+
+  // each change adds the next value to its history
+  cszt historyCount = MySession.ValuesHistories.size() + names.size();
+  map<szt, szt> added;
+  for (cszt_pair& change : changes) {
+    if (change.X >= historyCount) {
+      return false;
+    }
+    const szt size = change.X < MySession.ValuesHistories.size() ?
+                     MySession.ValuesHistories[change.X].size() : 0;
+    if (change.Y != size + ++added[change.X]) {
+      return false;
+    }
+  }
+  for (const Snapshot& snap : snapshots) {
+    if (snap.QueueIndex > MySession.QueueHistory.size() + queue.size()
+        || snap.AssetsIndex > MySession.AssetsHistory.size() + assets.size()
+        || snap.ChangesIndex > MySession.ValuesChanges.size()
+                               + changes.size()) {
+      return false;
+    }
+  }
+
+  const HistoryText& texts = MySession.HistoryTexts;
+  for (const text_view& value : queue) {
+    MySession.QueueHistory.push_back(texts.AddMapped(value));
+  }
+  for (const text_view& value : assets) {
+    MySession.AssetsHistory.push_back(texts.AddMapped(value));
+  }
+  for (const string& name : names) {
+    cszt historyI = MySession.ValuesHistories.size();
+    MySession.ValuesHistories.resize(historyI + 1);
+    if (name.empty()) {
+      MySession.ValuesHistoryNames.resize(historyI + 1, NO_SYMBOL);
+    } else {
+      MySession.SetValuesHistory(MySession.Symbols.Add(name), historyI);
+    }
+  }
+  for (szt i = 0, fSz = changes.size(); i < fSz; ++i) {
+    const uint value = texts.AddMapped(values[i]);
+    MySession.ValuesHistories[changes[i].X].push_back(value);
+    MySession.ValuesChanges.Add(changes[i]);
+  }
+  MySession.Snapshots.insert(MySession.Snapshots.end(),
+                             snapshots.begin(), snapshots.end());
+  return true;
+}
+
+bool SessionJournal::GetBookmarks(BinaryReader& Record, Session& MySession)
+{
+  map<szt, Bookmark> bookmarks;
+  cszt count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  for (szt i = 0; i < count && !Record.Failed; ++i) {
+    cszt index = Record.U32();
+    Record.Str(bookmarks[index].Description);
+  }
+  if (Record.Failed || Record.Pos != Record.Size) {
+    return false;
+  }
+  MySession.Bookmarks.swap(bookmarks);
+  return true;
+}
+
+/** @brief Add the keyframes if they follow the ones there are and fit the
+  * histories, ones that don't are left to be worked out from the changes
+  */
+bool SessionJournal::GetKeyframes(BinaryReader& Record, Session& MySession)
+{
+  cszt interval = Record.U32();
+  cszt first = Record.U32();
+  cszt count = Record.U32();
+  if (Record.Failed || count > Record.Size - Record.Pos) {
+    return false;
+  }
+  vector<vector<uint>> keyframes(count);
+  for (vector<uint>& keyframe : keyframes) {
+    cszt size = Record.U32();
+    if (Record.Failed || size > (Record.Size - Record.Pos) / 4) {
+      return false;
+    }
+    keyframe.resize(size);
+    for (uint& position : keyframe) {
+      position = Record.U32();
+    }
+  }
+  if (Record.Failed || Record.Pos != Record.Size) {
+    return false;
+  }
+
+  vector<vector<uint>>& kept = MySession.ValuesKeyframes;
+  if (interval != SESSION_KEYFRAME || first != kept.size()
+      || (first + count) * SESSION_KEYFRAME > MySession.ValuesChanges.size()) {
+    return true;
+  }
+  for (const vector<uint>& keyframe : keyframes) {
+    if (keyframe.size() > MySession.ValuesHistories.size()) {
+      return true;
+    }
+    for (szt i = 0, fSz = keyframe.size(); i < fSz; ++i) {
+      if (keyframe[i] > MySession.ValuesHistories[i].size()) {
+        return true;
+      }
+    }
+  }
+  kept.insert(kept.end(), keyframes.begin(), keyframes.end());
+  return true;
+}
+
+/** @brief Remember how much of the session is in the file
+  */
+void SessionJournal::Written(const Session& MySession)
+{
+  Name = MySession.Name;
+  BookName = MySession.BookName;
+  QueueCount = MySession.QueueHistory.size();
+  AssetsCount = MySession.AssetsHistory.size();
+  HistoriesCount = MySession.ValuesHistories.size();
+  ChangesCount = MySession.ValuesChanges.size();
+  SnapshotsCount = MySession.Snapshots.size();
+  KeyframesCount = MySession.ValuesKeyframes.size();
+}
+
+/** @brief Checksum of the last queue entry
+  */
+uint32_t SessionJournal::GetCheck(const Session& MySession) const
+{
+  if (MySession.QueueHistory.empty()) {
+    return 0;
+  }
+  const text_view& text = MySession.HistoryTexts.Get(
+                            MySession.QueueHistory.back());
+  return Checksum(text.Data, text.Size);
+}
@@ -0,0 +1,95 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include "main.h"
+
+class Session;
+class WriteQueue;
+struct BinaryReader;
+
+/** @brief Where a branched session continues from
+  */
+struct JournalParent {
+  // session file in the same folder, none if empty
+  string Filename;
+  // how much of each history the branch shares with it
+  szt QueueCount = 0;
+  szt AssetsCount = 0;
+  szt HistoriesCount = 0;
+  szt ChangesCount = 0;
+  szt SnapshotsCount = 1;
+  // not in the record, it's what's left of the keyframes after the cut
+  szt KeyframesCount = 0;
+  // of the last queue entry shared, in case the file isn't the same session
+  uint32_t Check = 0;
+};
+
+/** @brief Session file that only gets the turns played since the last save
+  * appended to it
+  *
+  * Each save adds a record with the new queue and asset entries, histories,
+  * value changes and snapshots, and one with the value keyframes added
+  * since so loading doesn't have to work them out again. Records carry their size and checksum so one
+  * cut short by a crash is dropped and everything before it still loads.
+  * After enough records, or when the history has been trimmed, the whole
+  * session is written into a new file that is then moved over the old one.
+  * The data is built on save and handed to the writer, which writes it on
+  * its own thread.
+  *
+  * A branch starts with a record of the session file it branched from and
+  * only holds what was played since. That file is loaded first and cut
+  * back to where the branch started, sessions only ever add to their files
+  * so what they share stays the same.
+  */
+class SessionJournal
+{
+public:
+  SessionJournal() { };
+  ~SessionJournal() { };
+
+  static bool IsJournal(const string& Filename);
+  bool Load(const string& Filename, Session& MySession);
+  bool Save(const string& Filename, const Session& MySession,
+            WriteQueue& Writer);
+  void Fork(const string& ParentFilename, const Session& MySession);
+  void Reset();
+
+private:
+  bool Read(const string& Filename, Session& MySession, cszt Depth);
+  void Rewind();
+  bool Compact(const string& Filename, const Session& MySession,
+               WriteQueue& Writer);
+  bool HasTurns(const Session& MySession) const;
+  void PutParent(string& Out) const;
+  void PutNames(string& Out, const Session& MySession) const;
+  void PutTurns(string& Out, const Session& MySession) const;
+  void PutBookmarks(string& Out, const Session& MySession) const;
+  void PutKeyframes(string& Out, const Session& MySession) const;
+  bool GetParent(BinaryReader& Record, const string& Filename,
+                 Session& MySession, cszt Depth);
+  bool GetNames(BinaryReader& Record, Session& MySession);
+  bool GetTurns(BinaryReader& Record, Session& MySession);
+  bool GetBookmarks(BinaryReader& Record, Session& MySession);
+  bool GetKeyframes(BinaryReader& Record, Session& MySession);
+  void Written(const Session& MySession);
+  uint32_t GetCheck(const Session& MySession) const;
+
+
+private:
+  // file the journal is in, nothing is appended to any other
+  string JournalFilename;
+  JournalParent Parent;
+  string Name;
+  string BookName;
+  // how much of each history is already in the file
+  szt QueueCount = 0;
+  szt AssetsCount = 0;
+  szt HistoriesCount = 0;
+  szt ChangesCount = 0;
+  szt SnapshotsCount = 1; // the zeroth is part of the initialisation
+  szt KeyframesCount = 0;
+  // records appended since the file was last written whole
+  szt Records = 0;
+};
+
+#endif // SESSIONJOURNAL_H
@@ -4,6 +4,7 @@
 #include "session.h"
 #include "storyquery.h"
 #include "properties.h"
+#include "workpool.h"
 
 Page Story::MissingPage = Page();
 
@@ -14,7 +15,14 @@ Story::~Story()
 
 void Story::Reset()
 {
+  StopWarmUp();
   Pages.clear();
+  PatternList.clear();
+  Patterns.clear();
+  Symbols.Clear();
+  Arena.Clear();
+  Image.Unmap();
+  UnparsedCount = 0;
 }
 
 void Story::Fixate()
@@ -22,6 +30,152 @@ void Story::Fixate()
   Patterns.clear();
 }
 
+/** @brief Parse the remaining pages in the background
+  *
+  * WarmedUp gets called from the warm up thread once all pages are parsed,
+  * it's not called if the story gets reset before that.
+  */
+void Story::WarmUp(const std::function<void()>& WarmedUp)
+{
+  StopWarmUp();
+  WarmUpThread = std::thread([this, WarmedUp]() {
+    for (auto& page : Pages) {
+      if (WarmUpStopping || !UnparsedCount) {
+        break;
+      }
+      if (page) {
+        ParsePage(*page);
+      }
+    }
+    if (!WarmUpStopping) {
+      WarmedUp();
+    }
+  });
+}
+
+/** @brief Parse the remaining pages right away
+  */
+void Story::ParsePages()
+{
+  StopWarmUp();
+  for (auto& page : Pages) {
+    if (!UnparsedCount) {
+      break;
+    }
+    if (page) {
+      ParsePage(*page);
+    }
+  }
+}
+
+void Story::StopWarmUp()
+{
+  if (WarmUpThread.joinable()) {
+    WarmUpStopping = true;
+    WarmUpThread.join();
+    WarmUpStopping = false;
+  }
+}
+
+/** @brief Run the parser on the page source if it hasn't been parsed yet
+  */
+void Story::ParsePage(Page& MyPage)
+{
+  std::lock_guard<std::mutex> parseLock(ParseMutex);
+  if (!MyPage.IsParsed()) {
+    string sourceText;
+    if (ApplyPatterns(MyPage)) {
+      sourceText.swap(MyPage.Source);
+    } else {
+      sourceText = MyPage.GetSource();
+      MyPage.Source.clear();
+      MyPage.Patterns.clear();
+    }
+    MyPage.Parse(sourceText, Arena);
+    MyPage.Patterns.clear();
+    MyPage.Keyword.clear();
+    --UnparsedCount;
+  }
+}
+
+/** @brief Copy the verbs of the shared patterns into the page
+  *
+  * Each part of the page text has to parse the same on its own as it
+  * would with the next part following it, otherwise nothing gets added
+  * and the patterns need to be expanded into the source instead.
+  */
+bool Story::ApplyPatterns(Page& MyPage)
+{
+  const vector<PagePattern*>& patterns = MyPage.Patterns;
+  for (szt i = 0, fSz = patterns.size(); i < fSz; ++i) {
+    const bool last = i + 1 == fSz;
+    const string& next = last ? MyPage.Source : patterns[i + 1]->Text;
+    if (!patterns[i]->CanApply(MyPage.Keyword, next, last, Arena)) {
+      return false;
+    }
+  }
+
+  for (szt i = 0, fSz = patterns.size(); i < fSz; ++i) {
+    patterns[i]->Apply(MyPage, MyPage.Keyword, i + 1 == fSz, Arena);
+  }
+  return true;
+}
+
+/** @brief Find the page of the noun, creating it if it's not there yet
+  */
+Page& Story::AddPage(const string& Noun)
+{
+  const uint symbol = Symbols.Add(Noun);
+  if (symbol >= Pages.size()) {
+    Pages.resize(symbol + 1);
+  }
+  if (!Pages[symbol]) {
+    Pages[symbol].reset(new Page());
+  }
+  return *Pages[symbol];
+}
+
+// below this many definitions per core threads aren't worth starting
+cszt MIN_DEFINITIONS_PER_THREAD = 64;
+
+/** @brief Prepare all the noun definition blocks of the story
+  *
+  * The texts come cleaned from the lexer, their headers are found on all
+  * cores but definitions are added in the order they appear in the story
+  * so patterns and duplicates behave the same as if they were added one
+  * at a time. Pages only keep their source and get parsed
+  * when they're first needed.
+  */
+void Story::ParseKeywordDefinitions(const vector<string>& StoryTexts)
+{
+  vector<KeywordDefinition> definitions(StoryTexts.begin(), StoryTexts.end());
+
+  WorkPool::Run(definitions.size(), [&definitions](szt i) {
+    PrepareDefinition(definitions[i]);
+  }, MIN_DEFINITIONS_PER_THREAD);
+
+  for (KeywordDefinition& definition : definitions) {
+    if (AddDefinition(definition)) {
+      AddSource(definition);
+    }
+  }
+}
+
+/** @brief Leave the noun text and its patterns for the parser, with the
+  * patterns known each page only depends on its own definition
+  */
+void Story::AddSource(KeywordDefinition& Definition)
+{
+  Page* page = Definition.Target;
+  if (page && (!Definition.PageText.empty()
+               || !Definition.Patterns.empty())) {
+    page->Source.swap(Definition.PageText);
+    page->Patterns.swap(Definition.Patterns);
+    page->Keyword = Definition.Noun;
+    ++UnparsedCount;
+  }
+}
+
 /** @brief ParseKeywordDefinition
   *
   * this expects a single noun definition block
@@ -29,18 +183,53 @@ void Story::Fixate()
   */
 bool Story::ParseKeywordDefinition(const string& StoryText)
 {
-  string text = GetCleanWhitespace(StoryText);
+  KeywordDefinition definition(StoryText);
+  CleanWhitespace(definition.Text);
+  PrepareDefinition(definition);
+  if (AddDefinition(definition)) {
+    AddSource(definition);
+    if (definition.Target) {
+      ParsePage(*definition.Target);
+    }
+    return true;
+  }
+  return false;
+}
+
+/** @brief Find the parts of the [noun] header of the cleaned text
+  *
+  * Doesn't touch the story so it's safe to run on many definitions at once
+  */
+void Story::PrepareDefinition(KeywordDefinition& Definition)
+{
+  const string& text = Definition.Text;
   // break up the expected [[pattern]] or [noun=value]
-  szt_pair nounPos = FindToken(text, token::noun); // [] outer
-  szt_pair patPos = FindToken(text, token::noun, nounPos.X + 1, nounPos.Y); // []
-  szt assignPos = FindTokenStart(text, token::assign, nounPos.X + 1, nounPos.Y);
+  const szt_pair& nounPos = Definition.NounPos = FindToken(text, token::noun);
+  const szt_pair& patPos = Definition.PatternPos
+                           = FindToken(text, token::noun, nounPos.X + 1,
+                                       nounPos.Y);
+  Definition.AssignPos = FindTokenStart(text, token::assign, nounPos.X + 1,
+                                        nounPos.Y);
 
   // cut the noun name
-  cszt nounEnd = min(min(nounPos.Y, patPos.X), assignPos);
-  const string& noun = CutString(text, nounPos.X + 1, nounEnd);
+  cszt nounEnd = min(min(nounPos.Y, patPos.X), Definition.AssignPos);
+  Definition.Noun = CutString(text, nounPos.X + 1, nounEnd);
+}
+
+/** @brief Add the page or the pattern to the story and find the patterns
+  * of the page, the page itself is left to be parsed by the caller
+  */
+bool Story::AddDefinition(KeywordDefinition& Definition)
+{
+  const string& text = Definition.Text;
+  const string& noun = Definition.Noun;
+  const szt_pair& nounPos = Definition.NounPos;
+  const szt_pair& patPos = Definition.PatternPos;
+  szt assignPos = Definition.AssignPos;
 
   // check if it's already defined
-  if (Pages.find(noun) != Pages.end()) {
+  const uint symbol = Symbols.Find(noun);
+  if (symbol < Pages.size() && Pages[symbol]) {
     LOG(noun + " - already defined");
     return false;
   }
@@ -48,21 +237,21 @@ bool Story::ParseKeywordDefinition(const string& StoryText)
   if (assignPos != string::npos) {
     // if it's not a pattern apply the initial values if present
     ++assignPos; // skip the =
-    Pages[noun].PageValues = Properties(CutString(text, assignPos, nounPos.Y));
+    AddPage(noun).PageValues = Properties(CutString(text, assignPos, nounPos.Y));
   }
 
-  string pageText;
-
   // check if the keyword contains a pattern name
   if (patPos.X != string::npos) {
     // if this is a pattern definition
     if (nounPos.X == patPos.X - 1) {
       const string& pattern = CutString(text, patPos.X + 1, patPos.Y);
       // try find the pattern in the defined patterns
-      map<string, string>::iterator it = Patterns.find(pattern);
+      map<string, PagePattern*>::iterator it = Patterns.find(pattern);
       // add a new pattern definition
       if (it == Patterns.end()) {
-        Patterns[pattern] = CutString(text, nounPos.Y + 1);
+        PatternList.emplace_back(new PagePattern(pattern,
+                                                 CutString(text, nounPos.Y + 1)));
+        Patterns[pattern] = PatternList.back().get();
         return true;
       } else {
         LOG(pattern + " - pattern already defined");
@@ -80,9 +269,12 @@ bool Story::ParseKeywordDefinition(const string& StoryText)
 
         const string& pattern = CutString(text, curPos.X + 1, curPos.Y);
         // try find the pattern in the defined patterns
-        map<string, string>::iterator it = Patterns.find(pattern);
+        map<string, PagePattern*>::iterator it = Patterns.find(pattern);
         if (it != Patterns.end()) {
-          pageText += PreparePattern(noun, it->first, it->second);
+          // empty patterns add nothing to the page
+          if (!it->second->Text.empty()) {
+            Definition.Patterns.push_back(it->second);
+          }
         } else {
           LOG(pattern + " - pattern definition missing");
         }
@@ -93,33 +285,9 @@ bool Story::ParseKeywordDefinition(const string& StoryText)
     }
   }
 
-  // append the rest of the noun definition
-  pageText += CutString(text, nounPos.Y + 1);
-
-  Pages[noun].Parse(pageText);
+  // the rest of the noun definition follows the patterns
+  Definition.PageText = CutString(text, nounPos.Y + 1);
+  Definition.Target = &AddPage(noun);
 
   return true;
 }
-
-/** @brief returns the patterns text with occurrences of the pattern keyword
-  * replaced with with the real keyword ready to be prepended to the noun definition
-  */
-string Story::PreparePattern(const string& Keyword,
-                             const string& PatternName,
-                             const string& PatternText)
-{
-  string text = PatternText;
-  szt pos = 0;
-  // replace the pattern name with the keyword
-  while (pos < text.size()) { // size changes along the way
-    szt patternPos = text.find(PatternName, pos);
-    if (patternPos != string::npos) {
-      text.replace(patternPos, PatternName.size(), Keyword);
-      pos = patternPos + Keyword.size();
-    } else {
-      break;
-    }
-  }
-
-  return text;
-}
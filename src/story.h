@@ -3,9 +3,31 @@
 
 #include "main.h"
 #include "page.h"
+#include "textarena.h"
+#include "symboltable.h"
+#include "file.h"
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 class Session;
 
+/** @brief A single [noun] block of the story source on its way to a page
+  */
+struct KeywordDefinition {
+  KeywordDefinition(const string& aText) : Text(aText) { };
+  string Text;
+  string Noun;
+  szt_pair NounPos;
+  szt_pair PatternPos;
+  szt AssignPos = 0;
+  // the text of the noun and the patterns that go before it
+  string PageText;
+  vector<PagePattern*> Patterns;
+  Page* Target = NULL;
+};
+
 class Story
 {
 public:
@@ -14,31 +36,63 @@ public:
 
   void Reset();
   void Fixate();
+  void WarmUp(const std::function<void()>& WarmedUp);
+  void ParsePages();
+  bool IsParsed() const
+  {
+    return !UnparsedCount;
+  };
 
+  void ParseKeywordDefinitions(const vector<string>& StoryTexts);
   bool ParseKeywordDefinition(const string& StoryText);
 
   inline Page& FindPage(const string& Noun);
 
 private:
-  string ApplyPatterns(const string& Keyword, const string& PageText);
-  string PreparePattern(const string& Keyword, const string& PatternName,
-                        const string& PatternText);
+  Page& AddPage(const string& Noun);
+  static void PrepareDefinition(KeywordDefinition& Definition);
+  bool AddDefinition(KeywordDefinition& Definition);
+  void ParsePage(Page& MyPage);
+  void StopWarmUp();
+  void AddSource(KeywordDefinition& Definition);
+  bool ApplyPatterns(Page& MyPage);
 
 
 private:
-  map<string, Page> Pages;
-  map<string, string> Patterns;
+  // pages are kept by the symbol of their noun, empty if it has no page
+  SymbolTable Symbols;
+  vector<std::unique_ptr<Page>> Pages;
+  // patterns are parsed once and kept until the pages using them are parsed
+  vector<std::unique_ptr<PagePattern>> PatternList;
+  map<string, PagePattern*> Patterns;
+  // all the text the parsed pages point into
+  TextArena Arena;
+  // the story cache the loaded pages point into
+  MappedFile Image;
+
+  // pages are parsed on first use so parsing has to be guarded
+  // for as long as the warm up thread is parsing the rest
+  std::atomic<szt> UnparsedCount{0};
+  std::atomic<bool> WarmUpStopping{false};
+  std::mutex ParseMutex;
+  std::thread WarmUpThread;
 
   static Page MissingPage;
+
+  friend class StoryCache;
 };
 
 /** @brief Return page for noun
   */
 Page& Story::FindPage(const string& Noun)
 {
-  const auto it = Pages.find(Noun);
-  if (it != Pages.end()) {
-    return it->second;
+  const uint symbol = Symbols.Find(Noun);
+  if (symbol < Pages.size() && Pages[symbol]) {
+    Page& page = *Pages[symbol];
+    if (UnparsedCount) {
+      ParsePage(page);
+    }
+    return page;
   }
   LOG(Noun + " - not defined in the story");
   return MissingPage;
@@ -0,0 +1,281 @@
+#include "storycache.h"
+#include "story.h"
+#include "page.h"
+#include "file.h"
+#include "disk.h"
+#include "binarydata.h"
+#include "library.h"
+
+const char CACHE_MAGIC[] = "LETHESI";
+// bump this whenever the layout of pages or blocks changes
+const uint32_t CACHE_VERSION = 1;
+// magic, version, page count, hash, asset count, reserved
+cszt CACHE_HEADER_SIZE = 8 + 4 + 4 + 8 + 4 + 4;
+
+const uchar BLOCK_EXECUTE = 0x01;
+const uchar BLOCK_ELSE = 0x02;
+
+/** @brief Text the verbs point to in the mapped image, followed by a zero
+  * so it can be parsed like text in the arena
+  */
+static void PutText(string& Out, const text_view& Text)
+{
+  PutString(Out, Text);
+  Out += '\0';
+}
+
+static void GetText(BinaryReader& Image, text_view& Text)
+{
+  Image.Str(Text);
+  if (Image.U8()) {
+    Image.Failed = true;
+  }
+}
+
+static void PutBlocks(string& Out, const vector<FlatBlock>& Blocks)
+{
+  PutU32(Out, Blocks.size());
+  for (const FlatBlock& block : Blocks) {
+    PutText(Out, block.Expression);
+    uchar flags = 0;
+    // only blocks with an expression are run or shown
+    if (block.Execute && !block.Expression.empty()) {
+      flags |= BLOCK_EXECUTE;
+    }
+    if (block.Else) {
+      flags |= BLOCK_ELSE;
+    }
+    Out += (char)flags;
+    PutU32(Out, block.End);
+    PutU32(Out, block.Parent);
+    PutU32(Out, block.Skip);
+    PutU32(Out, block.BreakUp);
+    PutU32(Out, block.Depth);
+  }
+}
+
+static bool GetBlocks(BinaryReader& Image, vector<FlatBlock>& Blocks)
+{
+  cszt count = Image.U32();
+  // every verb has at least the root block with its condition
+  if (Image.Failed || !count || count > Image.Size - Image.Pos) {
+    return false;
+  }
+  Blocks.resize(count);
+  for (szt i = 0; i < count; ++i) {
+    FlatBlock& block = Blocks[i];
+    GetText(Image, block.Expression);
+    const uchar flags = Image.U8();
+    block.Execute = flags & BLOCK_EXECUTE;
+    block.Else = flags & BLOCK_ELSE;
+    block.End = Image.U32();
+    block.Parent = Image.U32();
+    block.Skip = Image.U32();
+    block.BreakUp = Image.U32();
+    block.Depth = Image.U32();
+    // a corrupt image could send the executor outside the verb or loop it
+    if (Image.Failed || block.End <= i || block.End > count
+        || (i && block.Parent >= i) || (block.Else && block.Skip <= i)
+        || block.Skip > count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void StoryCache::PutPage(string& Out, const Page& MyPage)
+{
+  PutU64(Out, (uint64_t)MyPage.PageValues.IntValue);
+  PutU32(Out, MyPage.PageValues.TextValues.size());
+  for (const string& value : MyPage.PageValues.TextValues) {
+    PutString(Out, value);
+  }
+  PutString(Out, MyPage.Text);
+  // pages that haven't been parsed yet only have their source
+  PutString(Out, MyPage.GetSource());
+  PutU32(Out, MyPage.Verbs.size());
+  for (const VerbBlock& verb : MyPage.Verbs) {
+    PutText(Out, verb.VisualName);
+    PutU32(Out, verb.Names.size());
+    for (const text_view& name : verb.Names) {
+      PutText(Out, name);
+    }
+    PutBlocks(Out, verb.Blocks);
+  }
+}
+
+bool StoryCache::GetPage(BinaryReader& Image, Page& MyPage)
+{
+  MyPage.PageValues.IntValue = (lint)Image.U64();
+  cszt valueCount = Image.U32();
+  if (Image.Failed || valueCount > Image.Size - Image.Pos) {
+    return false;
+  }
+  MyPage.PageValues.TextValues.clear();
+  string value;
+  for (szt i = 0; i < valueCount; ++i) {
+    Image.Str(value);
+    MyPage.PageValues.TextValues.Add(value);
+  }
+  Image.Str(MyPage.Text);
+  Image.Str(MyPage.Source);
+  cszt verbCount = Image.U32();
+  if (Image.Failed || verbCount > Image.Size - Image.Pos) {
+    return false;
+  }
+  MyPage.Verbs.resize(verbCount);
+  for (VerbBlock& verb : MyPage.Verbs) {
+    GetText(Image, verb.VisualName);
+    cszt nameCount = Image.U32();
+    if (Image.Failed || nameCount > Image.Size - Image.Pos) {
+      return false;
+    }
+    verb.Names.resize(nameCount);
+    for (text_view& name : verb.Names) {
+      GetText(Image, name);
+    }
+    if (!GetBlocks(Image, verb.Blocks)) {
+      return false;
+    }
+    verb.Compile();
+  }
+  return !Image.Failed;
+}
+
+/** @brief Hash the contents of all the story files in the order they're read
+  */
+uint64_t StoryCache::HashSources(const string& Path,
+                                 const vector<string>& Filenames)
+{
+  uint64_t hash = FNV_OFFSET;
+  const string version = IntoString(CACHE_VERSION);
+  HashBytes(hash, version.data(), version.size());
+  szt i = Filenames.size();
+  while (i) { // same reverse order as the story gets read in
+    const string& filename = Filenames[--i];
+    HashBytes(hash, filename.c_str(), filename.size() + 1);
+    // the library only reads the files that changed since they were hashed
+    const uint64_t contents = Library::HashFile(Path + SLASH + filename);
+    HashBytes(hash, (const char*)&contents, sizeof(contents));
+  }
+  return hash;
+}
+
+/** @brief Fill the story with pages from the image if it's still fresh,
+  * the story keeps it mapped as the names and expressions of the verbs
+  * point into it
+  * \return false if the image is missing, stale or damaged
+  */
+bool StoryCache::Load(const string& Filename,
+                      const uint64_t Hash,
+                      Story& MyStory,
+                      vector<string_pair>& Assets)
+{
+  MappedFile& image = MyStory.Image;
+  if (!image.Map(Filename) || image.Size < CACHE_HEADER_SIZE) {
+    image.Unmap();
+    return false;
+  }
+  BinaryReader header(image.Data, image.Size);
+  if (string(image.Data, 7) != CACHE_MAGIC) {
+    LOG(Filename + " - not a story cache");
+    image.Unmap();
+    return false;
+  }
+  header.Pos = 8;
+  const uint32_t version = header.U32();
+  cszt pageCount = header.U32();
+  const uint64_t hash = header.U64();
+  cszt assetCount = header.U32();
+  if (version != CACHE_VERSION || hash != Hash) {
+    // the story changed since the image was made
+    image.Unmap();
+    return false;
+  }
+
+  BinaryReader index(image.Data, image.Size, CACHE_HEADER_SIZE);
+  cszt firstAsset = Assets.size();
+  for (szt i = 0; i < assetCount && !index.Failed; ++i) {
+    string_pair asset;
+    index.Str(asset.X);
+    index.Str(asset.Y);
+    Assets.push_back(asset);
+  }
+
+  string noun;
+  for (szt i = 0; i < pageCount && !index.Failed; ++i) {
+    index.Str(noun);
+    BinaryReader record(image.Data, image.Size, index.U32());
+    Page& page = MyStory.AddPage(noun);
+    if (index.Failed || !GetPage(record, page)) {
+      index.Failed = true;
+    } else if (!page.Source.empty()) {
+      ++MyStory.UnparsedCount;
+    }
+  }
+
+  if (index.Failed) {
+    LOG(Filename + " - damaged story cache, reparsing");
+    MyStory.Reset();
+    Assets.resize(firstAsset);
+    return false;
+  }
+  return true;
+}
+
+/** @brief Write the image of the parsed story so it doesn't need parsing
+  * next time the book is opened
+  */
+bool StoryCache::Save(const string& Filename,
+                      const uint64_t Hash,
+                      const Story& MyStory,
+                      const vector<string_pair>& Assets)
+{
+  // replaced whole as the story that loaded it may still have it mapped
+  return Disk::Replace(Filename, GetImage(Hash, MyStory, Assets));
+}
+
+/** @brief The image of the story, the same story always gives the same bytes
+  */
+const string StoryCache::GetImage(const uint64_t Hash,
+                                  const Story& MyStory,
+                                  const vector<string_pair>& Assets)
+{
+  string index;
+  string records;
+  for (const string_pair& asset : Assets) {
+    PutString(index, asset.X);
+    PutString(index, asset.Y);
+  }
+  // page offsets are only known once the index size is known
+  vector<uint> pageSymbols;
+  pageSymbols.reserve(MyStory.Pages.size());
+  vector<szt> recordOffsets;
+  recordOffsets.reserve(MyStory.Pages.size());
+  szt indexSize = index.size();
+  for (szt i = 0, fSz = MyStory.Pages.size(); i < fSz; ++i) {
+    if (MyStory.Pages[i]) {
+      pageSymbols.push_back(i);
+      recordOffsets.push_back(records.size());
+      PutPage(records, *MyStory.Pages[i]);
+      indexSize += 4 + MyStory.Symbols.GetName(i).size() + 4;
+    }
+  }
+  cszt recordsStart = CACHE_HEADER_SIZE + indexSize;
+  for (szt i = 0, fSz = pageSymbols.size(); i < fSz; ++i) {
+    PutString(index, MyStory.Symbols.GetName(pageSymbols[i]));
+    PutU32(index, recordsStart + recordOffsets[i]);
+  }
+
+  string image;
+  image.reserve(recordsStart + records.size());
+  image.append(CACHE_MAGIC, 8);
+  PutU32(image, CACHE_VERSION);
+  PutU32(image, pageSymbols.size());
+  PutU64(image, Hash);
+  PutU32(image, Assets.size());
+  PutU32(image, 0);
+  image += index;
+  image += records;
+  return image;
+}
@@ -0,0 +1,39 @@
+#ifndef STORYCACHE_H
+#define STORYCACHE_H
+
+#include "main.h"
+#include <stdint.h>
+
+class Story;
+class Page;
+struct BinaryReader;
+
+/** @brief Compiled story image kept next to the story sources
+  *
+  * The image holds the assets and the pages, parsed or still as source.
+  * All references inside are offsets from the start of the file so it can be
+  * mapped straight from disk. The verbs of the loaded pages point into the
+  * mapping, only the page texts and the blocks get copied out of it.
+  * It's only used if the hash of the sources it was built from still matches.
+  */
+class StoryCache
+{
+public:
+  StoryCache() { };
+  ~StoryCache() { };
+
+  static uint64_t HashSources(const string& Path,
+                              const vector<string>& Filenames);
+  static bool Load(const string& Filename, const uint64_t Hash,
+                   Story& MyStory, vector<string_pair>& Assets);
+  static bool Save(const string& Filename, const uint64_t Hash,
+                   const Story& MyStory, const vector<string_pair>& Assets);
+  static const string GetImage(const uint64_t Hash, const Story& MyStory,
+                               const vector<string_pair>& Assets);
+
+private:
+  static void PutPage(string& Out, const Page& MyPage);
+  static bool GetPage(BinaryReader& Image, Page& MyPage);
+};
+
+#endif // STORYCACHE_H
@@ -0,0 +1,207 @@
+#include "storylexer.h"
+#include "tokens.h"
+#include "file.h"
+#include "disk.h"
+#include <algorithm>
+
+/** @brief Which characters are statement tokens, looked up by the byte
+  */
+struct StatementTable {
+  StatementTable()
+  {
+    const char statements[] = {
+      token::Start[token::textBlock],
+      token::Start[token::noun],
+      token::End[token::noun],
+      token::Start[token::condition],
+      token::Start[token::instruction],
+      token::Start[token::block],
+      token::End[token::block]
+    };
+    for (const char c : statements) {
+      Statement[(unsigned char)c] = true;
+    }
+  };
+  bool Statement[256] = { };
+};
+
+static const StatementTable Statements;
+
+/** @brief Map the story file and split it into noun definitions
+  * and asset lines
+  * \return false if the file couldn't be read
+  */
+bool StoryLexer::ReadFile(const string& Filename,
+                          vector<string>& Definitions,
+                          vector<string>& AssetTexts)
+{
+  MappedFile story;
+  if (!story.Map(Filename)) {
+    // an empty file can't be mapped but is fine
+    if (!Disk::Exists(Filename)) {
+      LOG(Filename + " - missing file");
+      return false;
+    }
+    return true;
+  }
+  ReadText(text_view(story.Data, story.Size), Definitions, AssetTexts);
+  return true;
+}
+
+/** @brief Split the story text into noun definition blocks, each with
+  * its lines joined and its whitespace cleaned, and asset lines
+  */
+void StoryLexer::ReadText(const text_view& Text,
+                          vector<string>& Definitions,
+                          vector<string>& AssetTexts)
+{
+  const char* data = Text.Data;
+  cszt size = Text.size();
+  string definition;
+  szt pos = 0;
+
+  while (pos < size) {
+    const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+    szt end = newline ? newline - data : size;
+    cszt next = end + 1;
+    if (end > pos && data[end - 1] == '\r') {
+      --end;
+    }
+    // remove indentation and whitespace at the end
+    while (pos < end && (data[pos] == ' ' || data[pos] == '\t')) {
+      ++pos;
+    }
+    while (end > pos && (data[end - 1] == ' ' || data[end - 1] == '\t')) {
+      --end;
+    }
+
+    text_view line(data + pos, end - pos);
+    pos = next;
+
+    // ignore the rest of the line after //
+    if (line.size() > 1) {
+      const char commentA = token::Start[token::comment];
+      szt comment = FindUnescaped(line, commentA, commentA, 0,
+                                  line.size() - 1);
+      while (comment != string::npos
+             && line[comment + 1] != token::End[token::comment]) {
+        comment = FindUnescaped(line, commentA, commentA, comment + 1,
+                                line.size() - 1);
+      }
+      if (comment != string::npos) {
+        line.Size = comment;
+      }
+    }
+    if (line.empty()) {
+      continue;
+    }
+
+    // look for a keyword definition or asset definition
+    if (line.size() > 2
+        && line[0] == token::Start[token::noun]
+        && line[1] != token::Start[token::scope]) {
+      if (FindTokenEnd(line, token::noun) != string::npos) { // [noun]
+        if (!definition.empty()) {
+          // if it's the second keyword we hit on this run
+          // store the text and start a new run
+          CleanWhitespace(definition);
+          Definitions.push_back(definition);
+          definition.clear();
+        }
+        definition.append(line.Data, line.Size);
+      } else {
+        LOG(line.str() + " - malformed noun definition")
+      }
+    } else if (line[0] == token::Start[token::asset]) {
+      AssetTexts.push_back(line.str());
+    } else if (!definition.empty()) {
+      // we didn't find a keyword, keep adding lines if we already hit one
+      definition += ' '; // replace new lines with spaces
+      definition.append(line.Data, line.Size);
+    }
+  }
+
+  // last keyword definition
+  if (!definition.empty()) {
+    CleanWhitespace(definition);
+    Definitions.push_back(definition);
+  }
+}
+
+/** @brief Find all the unescaped statement characters of the page text
+  */
+void StoryLexer::FindTokens(const text_view& Text,
+                            vector<StoryToken>& Tokens)
+{
+  Tokens.clear();
+  const char* data = Text.Data;
+  for (szt pos = 0, length = Text.size(); pos < length; ++pos) {
+    const char c = data[pos];
+    if (Statements.Statement[(unsigned char)c]
+        && (pos == 0 || data[pos - 1] != '\\')) {
+      Tokens.push_back(StoryToken(c, pos));
+    }
+  }
+}
+
+/** @brief Index of the first token at or after From
+  */
+szt StoryLexer::FindFirst(const vector<StoryToken>& Tokens,
+                          cszt From)
+{
+  return lower_bound(Tokens.begin(), Tokens.end(), From,
+                     [](const StoryToken& Token, szt Pos) {
+                       return Token.Pos < Pos;
+                     }) - Tokens.begin();
+}
+
+/** @brief Same as FindCharacter for one of the statement characters
+  * \return npos if not found
+  */
+szt StoryLexer::FindToken(const vector<StoryToken>& Tokens,
+                          char Character,
+                          cszt From)
+{
+  for (szt i = FindFirst(Tokens, From), fSz = Tokens.size(); i < fSz; ++i) {
+    if (Tokens[i].Character == Character) {
+      return Tokens[i].Pos;
+    }
+  }
+  return string::npos;
+}
+
+/** @brief Find where the next statement starts, the closing ] isn't one
+  * \return npos if there are no more statements
+  */
+szt StoryLexer::FindStatement(const vector<StoryToken>& Tokens,
+                              cszt From)
+{
+  for (szt i = FindFirst(Tokens, From), fSz = Tokens.size(); i < fSz; ++i) {
+    if (Tokens[i].Character != token::End[token::noun]) {
+      return Tokens[i].Pos;
+    }
+  }
+  return string::npos;
+}
+
+/** @brief Count up nested pairs from the opening character at From
+  * until the matching closing one
+  * \return npos if not found
+  */
+szt StoryLexer::FindPairEnd(const vector<StoryToken>& Tokens,
+                            char Open,
+                            char Close,
+                            cszt From)
+{
+  szt matchCount = 1;
+  for (szt i = FindFirst(Tokens, From + 1), fSz = Tokens.size(); i < fSz;
+       ++i) {
+    const char c = Tokens[i].Character;
+    if (c == Open) {
+      ++matchCount;
+    } else if (c == Close && (--matchCount == 0)) {
+      return Tokens[i].Pos;
+    }
+  }
+  return string::npos;
+}
@@ -0,0 +1,46 @@
+#ifndef STORYLEXER_H
+#define STORYLEXER_H
+
+#include "main.h"
+
+/** @brief A character that starts or ends a statement of a page
+  * like " [ ] ? ! { }, found once before parsing
+  */
+struct StoryToken {
+  StoryToken(char aCharacter, szt aPos)
+    : Character(aCharacter), Pos(aPos) { };
+  char Character;
+  szt Pos;
+};
+
+/** @brief Turns story files and page texts into what the parsers need
+  * in a single pass over the text
+  *
+  * Files are split into lines, trimmed, have their comments removed and get
+  * sorted into noun definitions and asset lines while reading the mapped file.
+  * Pages get a stream of the unescaped statement characters so the parser
+  * can jump between statements instead of scanning for each kind again.
+  */
+class StoryLexer
+{
+public:
+  StoryLexer() { };
+  ~StoryLexer() { };
+
+  static bool ReadFile(const string& Filename, vector<string>& Definitions,
+                       vector<string>& AssetTexts);
+  static void ReadText(const text_view& Text, vector<string>& Definitions,
+                       vector<string>& AssetTexts);
+  static void FindTokens(const text_view& Text, vector<StoryToken>& Tokens);
+
+  static szt FindToken(const vector<StoryToken>& Tokens, char Character,
+                       cszt From);
+  static szt FindStatement(const vector<StoryToken>& Tokens, cszt From);
+  static szt FindPairEnd(const vector<StoryToken>& Tokens, char Open,
+                         char Close, cszt From);
+
+private:
+  static szt FindFirst(const vector<StoryToken>& Tokens, cszt From);
+};
+
+#endif // STORYLEXER_H
@@ -4,111 +4,125 @@
 #include "session.h"
 #include "book.h"
 #include "page.h"
+#include "compiledexpressions.h"
+#include "scratcharena.h"
+#include <algorithm>
 
-/** \brief Will recursively evaluate the Expression in each child block
-  * starting with current block and fill in Text resulting from the evaluation
-  * \return how many parents up do we go up to with !<<
+bool StoryQuery::UseVerbCode = false;
+
+/** \brief Runs all the blocks of the verb in order, only entering the blocks
+  * nested in conditions that pass and the else blocks after the ones that fail
+  * \return how many parents up the verb was broken out of with !<<
   */
-szt StoryQuery::ExecuteBlock(const string& Noun,
-                             const Block& CurBlock,
-                             cszt Level)
+szt StoryQuery::ExecuteVerb(const string& Noun,
+                            const VerbBlock& Verb)
 {
-  const string& expression = CurBlock.Expression;
-  if (Level > 100) {
-    LOG("Excessive call stack " + IntoString(Level) + " levels deep at:"
-        + expression);
-    if (Level > 1000) {
-      LOG("infinite (1000 levels deep) loop at: " + expression + ". Aborting.");
-      return 2000;
-    }
-  }
-  cszt length = expression.size();
-#ifdef DEVBUILD
-  if (GTrace[GTrace.size() - 1] != '\n') {
-    // don't add double breaklines (caused by empty expressions)
-    GTrace += "\n";
+  if (UseVerbCode) {
+    return ExecuteVerbCode(Noun, Verb);
   }
-  for (szt i = 0; i < Level + GTraceIndent; ++i) {
-    GTrace += "  ";
+
+  const vector<FlatBlock>& blocks = Verb.Blocks;
+  if (blocks.empty()) {
+    return 0;
   }
+
+  szt cur = 0;
+  while (true) {
+    const FlatBlock& curBlock = blocks[cur];
+#ifdef DEVBUILD
+    if (curBlock.Else) {
+      GTrace += "else";
+    }
 #endif
-  if (CurBlock.Blocks.empty()) {
+    szt backUp = ExecuteBlock(Noun, curBlock, Verb.Compiled,
+                              curBlock.End > cur + 1);
+
+    // find the next block to run, either the first nested block
+    // or the next one after it in its parent
+    szt parent = cur;
+    szt next = cur + 1;
+    bool executeElse = false;
+    bool done = backUp || curBlock.End == next;
+    while (true) {
+      if (done) {
+        // pass the result up to the parent
+        if (cur == 0) {
+          return backUp;
+        }
+        parent = blocks[cur].Parent;
+        if (backUp > 1) {
+          // this carries the !<< escape up the parents
+          --backUp;
+          cur = parent;
+          continue;
+        }
+        executeElse = (backUp == 1);
+        next = blocks[cur].End;
+      }
+      cszt parentEnd = blocks[parent].End;
+      if (next < parentEnd && blocks[next].Else && !executeElse) {
+        next = blocks[next].Skip;
+      }
+      if (next < parentEnd) {
+        break;
+      }
+      // all the nested blocks have run, continue in the parent's parent
+      done = true;
+      backUp = 0;
+      cur = parent;
+    }
+    cur = next;
+  }
+}
+
+/** \brief Evaluate the Expression of a single block and fill in Text
+  * resulting from the evaluation, nested blocks are left to the caller
+  * \return 0 if OK, 1 for a failed condition or how many parents up to go
+  * with !<<
+  */
+szt StoryQuery::ExecuteBlock(const string& Noun,
+                             const FlatBlock& CurBlock,
+                             const CompiledExpressions& Compiled,
+                             bool Nested)
+{
+  const text_view& expression = CurBlock.Expression;
+  cszt length = expression.size();
+  TraceBlock(CurBlock);
+  if (!Nested) {
     if (length) {
       if (CurBlock.Execute) {
         // if there are no child blocks it must be an !instruction
 #ifdef DEVBUILD
-        GTrace += "!" + expression;
+        GTrace += "!" + expression.str();
 #endif
         // this is a !<<
-        if (FindTokenStart(expression, token::stop) != string::npos) {
-          // we know that at least two < exist already
-          szt breakUp = 3;
-          while (breakUp < length
-                 && expression[breakUp] == token::Start[token::stop]) {
-            ++breakUp;
-          }
-          return breakUp; // this breaks out of n loops above
+        if (CurBlock.BreakUp) {
+          return CurBlock.BreakUp; // this breaks out of n blocks above
         } else {
 #ifdef DEVBUILD
           ++GTraceIndent;
 #endif
-          ExecuteExpression(Noun, expression);
+          if (CurBlock.Compiled == NO_EXPRESSION) {
+            ExecuteExpression(Noun, expression);
+          } else {
+            ExecuteExpression(Noun, Compiled, CurBlock.Compiled);
+          }
 #ifdef DEVBUILD
           --GTraceIndent;
 #endif
         }
       } else {
-#ifdef DEVBUILD
-        cszt sampleEnd = min((szt)40, FindCharacter(expression, '\n'));
-        GTrace += "\"" + CutString(expression, 0, sampleEnd);
-        if (expression.size() > sampleEnd) {
-          GTrace += "...\"";
-        } else {
-          GTrace += '\"';
-        }
-#endif
-        // handle plain text Expression by copying to the display page
-        if ((Text.empty() || Text[Text.size() - 1] != ' ')
-            && expression[0] != ',' && expression[0] != ' '
-            && expression[0] != '.') {
-          Text += " ";
-        }
-
-        Text += expression;
+        AppendText(expression);
       }
     }
   } else {
     // this block has children so this must be a ?condition
 #ifdef DEVBUILD
     if (length) {
-      GTrace += " ?" + expression;
+      GTrace += " ?" + expression.str();
     }
 #endif
-    if (length == 0 || ExecuteExpression(Noun, expression, true)) {
-      // if the condition is true, execute all the child blocks
-      bool executeElse = false;
-      for (szt i = 0, fSz = CurBlock.Blocks.size(); i < fSz; ++i) {
-        // if !<< used to escape parent break from loop
-        szt backUp = 0; // this will carry the escape up the call stack
-        if (!CurBlock.Blocks[i].Else || executeElse) {
-#ifdef DEVBUILD
-          if (CurBlock.Blocks[i].Else) {
-            GTrace += "else";
-          }
-#endif
-          backUp = ExecuteBlock(Noun, CurBlock.Blocks[i], Level + 1);
-        }
-
-        executeElse = false;
-        if (backUp > 0) {
-          if (backUp == 1) {
-            executeElse = true;
-          } else {
-            return --backUp;
-          }
-        }
-      }
-    } else {
+    if (length && !ExecuteExpression(Noun, Compiled, CurBlock.Compiled)) {
 #ifdef DEVBUILD
       GTrace += " (failed) ";
 #endif
@@ -116,119 +130,235 @@ szt StoryQuery::ExecuteBlock(const string& Noun,
     }
   }
 
-  // all OK, continue parent execution normally
+  // all OK, continue with the nested blocks if there are any
   return 0;
 }
 
-/** @brief Get verbs that don't fail their verb expression
+/** \brief Start the trace line of the block
+  */
+void StoryQuery::TraceBlock(const FlatBlock& CurBlock)
+{
+#ifdef DEVBUILD
+  if (GTrace[GTrace.size() - 1] != '\n') {
+    // don't add double breaklines (caused by empty expressions)
+    GTrace += "\n";
+  }
+  for (szt i = 0; i < CurBlock.Depth + GTraceIndent; ++i) {
+    GTrace += "  ";
+  }
+#else
+  (void)CurBlock;
+#endif
+}
+
+/** \brief Handle plain text Expression by copying to the display page
+  */
+void StoryQuery::AppendText(const text_view& Expression)
+{
+#ifdef DEVBUILD
+  cszt sampleEnd = min((szt)40, FindCharacter(Expression, '\n'));
+  GTrace += "\"" + CutString(Expression, 0, sampleEnd);
+  if (Expression.size() > sampleEnd) {
+    GTrace += "...\"";
+  } else {
+    GTrace += '\"';
+  }
+#endif
+  if ((Text.empty() || Text[Text.size() - 1] != ' ')
+      && Expression[0] != ',' && Expression[0] != ' '
+      && Expression[0] != '.') {
+    Text += " ";
+  }
+
+  Text.append(Expression.Data, Expression.Size);
+}
+
+/** \brief Runs the verb code compiled from the blocks, does the same as
+  * ExecuteVerb but the jumps between the blocks are already worked out
+  * \return how many parents up the verb was broken out of with !<<
+  */
+szt StoryQuery::ExecuteVerbCode(const string& Noun,
+                                const VerbBlock& Verb)
+{
+  const vector<VerbCode>& code = Verb.Code;
+  if (code.empty()) {
+    return 0;
+  }
+
+  szt cur = 0;
+  while (true) {
+    const VerbCode& instruction = code[cur];
+    if (instruction.Operation == verbReturn) {
+      return instruction.Next;
+    }
+    const FlatBlock& curBlock = Verb.Blocks[cur];
+#ifdef DEVBUILD
+    if (curBlock.Else) {
+      GTrace += "else";
+    }
+#endif
+    TraceBlock(curBlock);
+    cur = instruction.Next;
+
+    switch (instruction.Operation) {
+      case verbText:
+        AppendText(curBlock.Expression);
+        break;
+      case verbInstruction:
+#ifdef DEVBUILD
+        GTrace += "!" + curBlock.Expression.str();
+        ++GTraceIndent;
+#endif
+        ExecuteExpression(Noun, Verb.Compiled, curBlock.Compiled);
+#ifdef DEVBUILD
+        --GTraceIndent;
+#endif
+        break;
+      case verbCondition:
+#ifdef DEVBUILD
+        GTrace += " ?" + curBlock.Expression.str();
+#endif
+        if (!ExecuteExpression(Noun, Verb.Compiled, curBlock.Compiled)) {
+#ifdef DEVBUILD
+          GTrace += " (failed) ";
+#endif
+          cur = instruction.Fail;
+        }
+        break;
+      case verbBreak:
+#ifdef DEVBUILD
+        GTrace += "!" + curBlock.Expression.str();
+#endif
+        cur = instruction.Fail;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/** @brief Get verbs that don't fail their verb expression, the list is kept
+  * in the session until the values read by the conditions change
   */
 Properties StoryQuery::GetVerbs(const string& Noun)
 {
+  const uint symbol = QuerySession.Symbols.Add(Noun);
+  const Properties* cached = QuerySession.FindVerbs(symbol);
+  if (cached) {
+    return *cached;
+  }
+
   Properties Result;
   const Page& page = QueryStory.FindPage(Noun);
+  // nouns read by the conditions, unless they depend on values themselves
+  // in which case they get recorded as they're read
+  vector<uint> reads;
+  bool cacheable = true;
+  bool dynamic = false;
+  for (const VerbBlock& verb : page.Verbs) {
+    if (verb.VisualName.empty() || verb.Condition == NO_EXPRESSION) {
+      continue;
+    }
+    const ExpressionReads& conditionReads = verb.ConditionReads;
+    cacheable &= !conditionReads.Volatile;
+    dynamic |= conditionReads.Dynamic;
+    if (conditionReads.Self) {
+      reads.push_back(symbol);
+    }
+    for (const text_view& noun : conditionReads.Nouns) {
+      reads.push_back(QuerySession.Symbols.Add(noun.str()));
+    }
+  }
+  sort(reads.begin(), reads.end());
+  reads.erase(unique(reads.begin(), reads.end()), reads.end());
+
+  // conditions can list verbs of other nouns through bare noun:verb
+  vector<uint>* outerReads = Reads;
+  const bool outerSideEffects = SideEffects;
+  Reads = (cacheable && dynamic) ? &reads : NULL;
+  SideEffects = false;
+
   for (szt i = 0, fSz = page.Verbs.size(); i < fSz; ++i) {
     const VerbBlock& verb = page.Verbs[i];
     if (!verb.VisualName.empty()) {
-      if (ExecuteExpression(Noun, verb.BlockTree.Expression, true)) {
-        Result.AddValue(verb.VisualName);
+      if (verb.Condition == NO_EXPRESSION
+          || ExecuteExpression(Noun, verb.Compiled, verb.Condition)) {
+        Result.AddValue(verb.VisualName.str());
       }
     }
   }
+
+  if (cacheable && !SideEffects) {
+    QuerySession.StoreVerbs(symbol, Result, reads);
+  }
+  Reads = outerReads;
+  SideEffects |= outerSideEffects;
   return Result;
 }
 
-/** @brief Parses the instruction or condition, checks for user values
-  * and modifies them if needed
+/** @brief Remember the noun was read while listing verbs
+  */
+void StoryQuery::RecordRead(const string& Noun)
+{
+  if (Reads) {
+    const uint symbol = QuerySession.Symbols.Add(Noun);
+    if (find(Reads->begin(), Reads->end(), symbol) == Reads->end()) {
+      Reads->push_back(symbol);
+    }
+  }
+}
+
+/** @brief Compiles the instruction or condition and executes it,
+  * used for expressions that don't come from the blocks of a verb
   */
 bool StoryQuery::ExecuteExpression(const string& Noun,
-                                   const string& Expression,
+                                   const text_view& Expression,
                                    bool Condition)
 {
-  szt length = Expression.size();
-  szt pos = 0;
-  bool shortAnd = false;
-  bool shortOr = false;
+  ScratchScope scope(QueryBook.Scratch);
+  CompiledExpressions& compiled = QueryBook.Scratch.AddCompiled();
+  cszt index = compiled.Add(Expression, Condition);
+  return ExecuteExpression(Noun, compiled, index);
+}
+
+/** @brief Runs the compiled instruction or condition, checks for user values
+  * and modifies them if needed
+  */
+bool StoryQuery::ExecuteExpression(const string& Noun,
+                                   const CompiledExpressions& Compiled,
+                                   szt Index)
+{
+  const CompiledExpression& expression = Compiled.Expressions[Index];
+  ScratchArena& scratch = QueryBook.Scratch;
   bool result = true;
 
   // might contain a chain of expressions so loop through them
-  while (pos < length) {
+  for (szt i = 0; i < expression.ClauseCount; ++i) {
+    // temporaries of the clause are released at the end of the iteration
+    ScratchScope scope(scratch);
+    const ExpressionClause& clause = Compiled.Clauses[expression.FirstClause + i];
+    const token::tokenName op = clause.Operation;
     result = true;
-    token::tokenName op = token::add;
-    cszt aPos = FindCharacter(Expression, token::Start[token::logicalAnd], pos);
-    cszt oPos = FindCharacter(Expression, token::Start[token::logicalOr], pos);
-    cszt endPos = min(length, min(aPos, oPos));
-
-    if (endPos < length) {
-      if (aPos < oPos) {
-        shortAnd = true;
-        shortOr = false;
-      } else {
-        shortAnd = false;
-        shortOr = true;
-      }
-    }
-
-    if (Condition) {
-      // check which condition it is
-      // TODO: do this in one scan
-      // Keep calm, this is just an unrolled loop
-      op = token::contains;
-      szt_pair opPos = FindToken(Expression, op, pos, endPos);
-      if (opPos.X == string::npos) {
-        op = token::notContains;
-        opPos = FindToken(Expression, op, pos, endPos);
-        if (opPos.X == string::npos) {
-          op = token::notEquals;
-          opPos = FindToken(Expression, op, pos, endPos);
-          if (opPos.X == string::npos) {
-            op = token::equalsOrLess;
-            opPos = FindToken(Expression, op, pos, endPos);
-            if (opPos.X == string::npos) {
-              op = token::equalsOrMore;
-              opPos = FindToken(Expression, op, pos, endPos);
-              if (opPos.X == string::npos) {
-                op = token::equals;
-                opPos = FindToken(Expression, op, pos, endPos);
-                if (opPos.X == string::npos) {
-                  op = token::isMore;
-                  opPos = FindToken(Expression, op, pos, endPos);
-                  if (opPos.X == string::npos) {
-                    op = token::isLess;
-                    opPos = FindToken(Expression, op, pos, endPos);
-                    if (opPos.X == string::npos) {
-                      op = token::condition; // [?value]
-                      // no comparison, just a bare condition
-                    }
-                  }
-                }
-              }
-            }
-          }
-        }
-      } // Keep calm, this was just an unrolled loop
 
+    if (expression.Condition) {
       // bare conditions have different syntax because no comparison
       if (op != token::condition) {
         bool isNum = false, isText = false;
-        const string& left = CutString(Expression, pos, opPos.X);
-        const string& right = CutString(Expression, opPos.Y + 1, endPos);
-
-        Properties rightValues;
-        Properties leftEvalValues;
-        EvaluateExpression(rightValues, right, isNum, isText);
+        Properties& rightValues = scratch.AddValues();
+        Properties& leftEvalValues = scratch.AddValues();
+        EvaluateExpression(rightValues, Compiled, clause.Right, isNum, isText);
         // default to current page noun
-        if (!left.empty()) {
-          EvaluateExpression(leftEvalValues, left, isNum, isText);
+        if (!clause.LeftEmpty) {
+          EvaluateExpression(leftEvalValues, Compiled, clause.Left,
+                             isNum, isText);
 #ifdef DEVBUILD
-          if (FindTokenStart(left, token::number) == string::npos
-              && FindTokenStart(left, token::value) == string::npos
-              && FindTokenStart(left, token::function) == string::npos) {
-            LOG("warning: ?" + Expression
+          if (clause.WarnLeft) {
+            LOG("warning: ?" + expression.Text.str()
                 + " - did you forget a @ or # on the left?");
           }
 #endif
         }
-        const Properties& leftValues = left.empty() ?
+        const Properties& leftValues = clause.LeftEmpty ?
                                        GetValues(Noun)
                                        : leftEvalValues;
 
@@ -282,38 +412,20 @@ bool StoryQuery::ExecuteExpression(const string& Noun,
         }
       }
     } else { // instruction
-      // check which assignment operation it is
-      szt_pair opPos = FindToken(Expression, op, pos, endPos);
-      if (opPos.X == string::npos) {
-        op = token::remove;
-        opPos = FindToken(Expression, op, pos, endPos);
-        if (opPos.X == string::npos) {
-          op = token::assign;
-          opPos = FindToken(Expression, op, pos, endPos);
-          if (opPos.X == string::npos) {
-            op = token::instruction; // [!value]
-            // no assignment, just a bare instruction
-          }
-        }
-      } // TODO: do this in one scan
-
       // bare instructions have different syntax because no assignment
       if (op != token::instruction) {
         bool isNum = false, isText = false;
-        Properties leftValues;
-        Properties rightValues;
-
-        const string& left = CutString(Expression, pos, opPos.X);
-        const string& right = CutString(Expression, opPos.Y + 1, endPos);
+        Properties& leftValues = scratch.AddValues();
+        Properties& rightValues = scratch.AddValues();
 
         // default to current page noun
-        if (left.empty()) {
+        if (clause.LeftEmpty) {
           leftValues.AddValue(Noun);
         } else {
-          EvaluateExpression(leftValues, left, isNum, isText);
+          EvaluateExpression(leftValues, Compiled, clause.Left, isNum, isText);
         }
 
-        EvaluateExpression(rightValues, right, isNum, isText);
+        EvaluateExpression(rightValues, Compiled, clause.Right, isNum, isText);
 
         // assign right values to all nouns whose name is in left values
         for (const string& text : leftValues.TextValues) {
@@ -321,7 +433,7 @@ bool StoryQuery::ExecuteExpression(const string& Noun,
 
           switch (op) {
             case token::assign:
-              if (isText || right.empty()) {
+              if (isText || clause.RightEmpty) {
                 userValues.SetValues(rightValues);
               }
               if (isNum && userValues.IntValue != rightValues.IntValue) {
@@ -355,26 +467,24 @@ bool StoryQuery::ExecuteExpression(const string& Noun,
     }
 
     if (op == token::condition || op == token::instruction) {
-      const string& evaluate = CutString(Expression, pos, endPos);
       bool isNum, isText;
-      Properties values;
-      EvaluateExpression(values, evaluate, isNum, isText);
+      Properties& values = scratch.AddValues();
+      EvaluateExpression(values, Compiled, clause.Left, isNum, isText);
 
       // execute !noun:verb commands and !noun=value assignments
       for (const string& text : values.TextValues) {
-        string noun, verb;
+        text_view noun, verb;
         if (ExtractNounVerb(text, noun, verb)) {
+          SideEffects = true;
           // if no noun, use the current page noun by default
-          if (noun.empty()) {
-            noun = Noun;
-          }
-          const Page& page = QueryStory.FindPage(noun);
-          const Block& block = page.GetVerb(verb).BlockTree;
-          result &= ExecuteBlock(noun, block);
+          const string& verbNoun = noun.empty() ? Noun : noun.str();
+          const Page& page = QueryStory.FindPage(verbNoun);
+          result &= ExecuteVerb(verbNoun, page.GetVerb(verb));
         }
 
         cszt assignPos = FindTokenStart(text, token::assign);
         if (assignPos != string::npos) {
+          SideEffects = true;
           result &= ExecuteExpression(Noun, text);
         }
       }
@@ -383,130 +493,66 @@ bool StoryQuery::ExecuteExpression(const string& Noun,
       result = values.IntValue + values.TextValues.size();
     }
 
-    pos = endPos;
-    ++pos;
-
     // short circuit logical & and |
-    if (shortAnd && !result) {
+    if (clause.ShortAnd && !result) {
       return false;
-    } else if (shortOr && result) {
+    } else if (clause.ShortOr && result) {
       return true;
     }
-  } // end while
+  } // end for
 
   return result;
 }
 
-struct OperationNode {
-  token::operationName Operation = token::plus;
-  Properties Operand;
-  bool Nested = true; // nested doesn't have operand, copy from result of next
-};
-
 /** @brief Evaluates keywords to their contents and does arithmetic
   */
 bool StoryQuery::EvaluateExpression(Properties& Result,
-                                    const string& Expression,
+                                    const CompiledExpressions& Compiled,
+                                    uint Value,
                                     bool& IsNum,
                                     bool& IsText)
 {
   // important hints to determine type of assignment
   IsNum = false;
   IsText = false;
-  szt length = Expression.size();
-  szt pos = 0;
-  szt valuePos = 0;
-  szt valueEnd = 0; // needed because function names vary in length
-  vector<OperationNode> opStack;
-  opStack.reserve(16); // too avoid constant allocations
-
-  // parse expressions like a+@b-func(arg)-#1
-  // into an array of pairs like this
-  // +,a  +,_ <- @,b  -,func_ <- (,arg  -,_ <- #,1
-  // _ <- means that the next pair will write its result there
-  // in case of functions it will replace the values that are the func names
-  while (pos < length) {
-    const char c = Expression[pos];
-    bool valueFound = false;
-    bool opFound = false;
-    bool funcFound = false;
-
-    if (c == '\\') {
-      // ignore escaped characters
-      ++pos;
-    } else if (pos + 1 >= length) {
-      valueFound = true;
-      valueEnd = ++pos;
-      // at least one op needed to store the value
-      if (opStack.empty()) {
-        opStack.resize(1);
-      }
-    } else {
-      // look for operators that delimate values
-      for (szt i = 0; i < token::OPERATION_NAME_MAX; ++i) {
-        if (token::Operations[i] == c) {
-          opFound = true;
-          valueEnd = pos;
-          valueFound = true;
-          if (pos > 0) {
-            // unless the expression starts with an operator we need
-            // a previous op to store the value in
-            if (opStack.empty()) {
-              opStack.resize(1);
-            }
-          }
-          opStack.resize(opStack.size() + 1);
-
-          // grouping and function calls recurse with the (contents)
-          if (i == token::parens) {
-            cszt funcEnd = FindTokenEnd(Expression, token::function,
-                                        pos);
-            if (funcEnd == string::npos) {
-              LOG(Expression + " - unmatched \"(\" in expression");
-              return false;
-            } else {
-              funcFound = true;
-              // a function need a previous op to store the func names in
-
-              opStack.back().Nested = false; // the arguments are the value
-              // prepare function arguments by evaluating recursively
-              const string& funcArgs = CutString(Expression, pos + 1, funcEnd);
-              EvaluateExpression(opStack.back().Operand, funcArgs,
-                                 IsNum, IsText);
-            }
-            pos = funcEnd;
-          }
-
-          opStack.back().Operation = (token::operationName)i;
-          break;
-        }
-      }
+  const ExpressionValue& value = Compiled.Values[Value];
+  const ExpressionNode* nodes = Compiled.Nodes.data() + value.FirstNode;
+  cszt stackSize = value.NodeCount;
+  // operands of the nodes, nested doesn't have operand, copy from result
+  // of next, the arguments evaluated below take the entries after them
+  ScratchArena& scratch = QueryBook.Scratch;
+  ScratchScope scope(scratch);
+  cszt opStack = scratch.AddValues(stackSize);
+
+  // fill in the operands of the nodes compiled from a+@b-func(arg)-#1
+  for (szt i = 0; i < stackSize; ++i) {
+    const ExpressionNode& node = nodes[i];
+    ScratchValues& op = scratch[opStack + i];
+    op.Nested = node.Nested;
+    if (node.Arguments) {
+      // prepare function arguments by evaluating recursively
+      EvaluateExpression(op.Values, Compiled, node.Arguments - 1,
+                         IsNum, IsText);
     }
-
-    if (valueFound && valueEnd > valuePos) {
-      // if an op was found this iteration, assign value to the previous op
-      OperationNode& lastOp = opFound ? *(opStack.rbegin() + 1) : opStack.back();
-      const string& valueText = CutString(Expression, valuePos, valueEnd);
-      // a value terminates a series of nested operators
-      lastOp.Nested = funcFound; // unless it was a function
-      lastOp.Operand.AddValue(valueText);
+    if (!node.Numeric) {
+      for (szt j = 0; j < node.LiteralCount; ++j) {
+        op.Values.AddValue(Compiled.Literals[node.FirstLiteral + j].str());
+      }
     }
+  }
 
-    ++pos;
-
-    if (opFound) {
-      valuePos = pos;
-    }
+  if (value.Unmatched) {
+    LOG(value.Text.str() + " - unmatched \"(\" in expression");
+    return false;
   }
 
   szt opI = 0; // current operation
   szt nextOp = 0; // next operation after nesting is finished
-  cszt stackSize = opStack.size();
   // traverse the tree, do math operations and accumulate the result
   while (opI < stackSize) {
     bool nested = false;
     // go to the end of nested ops
-    while (opI < stackSize && opStack[opI].Nested) {
+    while (opI < stackSize && scratch[opStack + opI].Nested) {
       ++opI;
       nested = true;
     }
@@ -516,19 +562,20 @@ bool StoryQuery::EvaluateExpression(Properties& Result,
       if (nextOp < opI) {
         nextOp = opI + 1;
       }
-      opStack[opI - 1].Nested = false; // the result will be copied there
-    } else if (opI > 0 && opStack[opI - 1].Nested) {
+      scratch[opStack + opI - 1].Nested = false; // the result goes there
+    } else if (opI > 0 && scratch[opStack + opI - 1].Nested) {
       // we have a nested value behind us
       // we're in the middle of collapsing a nesting
       nested = true;
-      opStack[opI - 1].Nested = false; // the result will be copied there
+      scratch[opStack + opI - 1].Nested = false; // the result goes there
     }
 
-    Properties& operand = opStack[opI].Operand;
+    const ExpressionNode& node = nodes[opI];
+    Properties& operand = scratch[opStack + opI].Values;
     // when dealing with nested values copy values to previous operand
-    Properties& target = nested ? opStack[opI - 1].Operand : Result;
+    Properties& target = nested ? scratch[opStack + opI - 1].Values : Result;
 
-    switch (opStack[opI].Operation) {
+    switch (node.Operation) {
       case token::plus:
         if (!operand.TextValues.empty()) {
           IsText = true;
@@ -560,7 +607,8 @@ bool StoryQuery::EvaluateExpression(Properties& Result,
       case token::parens:
         // all parens are preceded by nested
         // target is the previous op containing function names
-        ExecuteFunction(target, operand);
+        ExecuteFunction(target, operand, node.KnownFunctions ?
+                        Compiled.Functions.data() + node.FirstFunction : NULL);
         // replace the function names with the results
         target.SetValues(operand);
         target.IntValue = operand.IntValue;
@@ -569,14 +617,24 @@ bool StoryQuery::EvaluateExpression(Properties& Result,
       case token::evaluate:
         IsText = true;
         // evaluate all text into noun values, add them up and reuse the value
-        for (string text : operand.TextValues) {
+        for (const string& text : operand.TextValues) {
           // try to find the Values of this noun, user values first
           GetUserTextValues(text, target);
         }
         break;
       case token::integer:
+        if (node.Numeric) {
+          // plain numbers have been added up already, only nouns are left
+          target.IntValue += node.Number;
+          for (szt j = 0; j < node.LiteralCount; ++j) {
+            GetUserInteger(Compiled.Literals[node.FirstLiteral + j].str(),
+                           target);
+          }
+          IsNum = true;
+          break;
+        }
         // evaluate all text into int values, add them up and reuse the value
-        for (string numberText : operand.TextValues) {
+        for (const string& numberText : operand.TextValues) {
           // check for a plain text number (keywords can't start with a digit)
           if (isdigit(numberText[0]) || numberText[0] == '-') {
             target.IntValue += IntoInt(numberText);
@@ -602,7 +660,7 @@ bool StoryQuery::EvaluateExpression(Properties& Result,
     }
   }
 
-  return !opStack.empty();
+  return stackSize > 0;
 }
 
 /** @brief Fills in the dialog with text based on the verb found in the Noun
@@ -616,9 +674,10 @@ bool StoryQuery::CreateDialog(const string& Noun, Dialog& NewDialog)
     // you can't have a dialog with no buttons
     return false;
   }
-  NewDialog.Buttons = verbs.TextValues;
+  NewDialog.Buttons = verbs.TextValues.GetValues();
   // contents of the noun used as the message
-  Properties values;
+  ScratchScope scope(QueryBook.Scratch);
+  Properties& values = QueryBook.Scratch.AddValues();
   GetUserTextValues(Noun, values);
   for (const string& text : values.TextValues) {
     NewDialog.Message += text;
@@ -626,56 +685,26 @@ bool StoryQuery::CreateDialog(const string& Noun, Dialog& NewDialog)
   return true;
 }
 
-const map<const string, cszt> FunctionNameMap = {
-  { "Size", bookFunctionSize },
-  { "Play", bookFunctionPlay },
-  { "Stop", bookFunctionStop },
-  { "Keyword", bookFunctionKeyword },
-  { "SelectValue", bookFunctionSelectValue },
-  { "Print", bookFunctionPrint },
-  { "CloseMenu", bookFunctionCloseMenu },
-  { "OpenMenu", bookFunctionOpenMenu },
-  { "CloseBook", bookFunctionCloseBook },
-  { "OpenBook", bookFunctionOpenBook },
-  { "Quit", bookFunctionQuit },
-  { "GetBooks", bookFunctionGetBooks },
-  { "IsInGame", bookFunctionIsInGame },
-  { "GetSessions", bookFunctionGetSessions },
-  { "GetSessionName", bookFunctionGetSessionName },
-  { "SaveSession", bookFunctionSaveSession },
-  { "BranchSession", bookFunctionBranchSession },
-  { "LoadSession", bookFunctionLoadSession },
-  { "NewSession", bookFunctionNewSession },
-  { "Bookmark", bookFunctionBookmark },
-  { "UserBookmark", bookFunctionUserBookmark },
-  { "LoadSnapshot", bookFunctionLoadSnapshot },
-  { "GetSnapshots", bookFunctionGetSnapshots },
-  { "GetBookmarks", bookFunctionGetBookmarks },
-  { "GetSnapshotIndex", bookFunctionGetSnapshotIndex },
-  { "Dialog", bookFunctionDialog },
-  { "Input", bookFunctionInput }
-};
-
-/** @brief Executes all functions on all argument values
+/** @brief Executes all functions on all argument values,
+  * Functions are the FunctionName values already translated if known
   */
 bool StoryQuery::ExecuteFunction(const Properties& FunctionName,
-                                 Properties& FunctionArgs)
+                                 Properties& FunctionArgs,
+                                 const szt* Functions)
 {
   lint& intArg = FunctionArgs.IntValue;
-  vector<string>& textArgs = FunctionArgs.TextValues;
-  for (const string& func : FunctionName.TextValues) {
+  ValueSet& textArgs = FunctionArgs.TextValues;
+  for (szt i = 0, fSz = FunctionName.TextValues.size(); i < fSz; ++i) {
+    const string& func = FunctionName.TextValues[i];
     // translate string into an enum
-    szt functionIndex = BOOK_FUNCTION_MAX;
-    const auto it = FunctionNameMap.find(func);
-    if (it != FunctionNameMap.end()) {
-      functionIndex = it->second;
-    }
+    cszt functionIndex = Functions ? Functions[i]
+                         : CompiledExpressions::FindFunction(func);
     switch (functionIndex) {
       case bookFunctionSize:
         // return number of values
         intArg = 0;
         for (const string& arg : textArgs) {
-          const Properties nounValues = GetValues(arg);
+          const Properties& nounValues = GetValues(arg);
           intArg += nounValues.TextValues.size();
         }
         textArgs.clear();
@@ -899,19 +928,35 @@ bool StoryQuery::ExecuteFunction(const Properties& FunctionName,
   */
 Properties& StoryQuery::GetUserValues(const string& Noun)
 {
-  if (!QuerySession.IsUserValues(Noun)) {
-    QuerySession.UserValues[Noun] = QueryStory.FindPage(Noun).PageValues;
+  Properties& values = AddUserValues(Noun);
+  // the values are about to be written to
+  QuerySession.ChangeValues(QuerySession.Symbols.Find(Noun));
+  return values;
+}
+
+/** @brief return user values, copied from the story if there aren't any,
+  * without marking them as changed
+  */
+Properties& StoryQuery::AddUserValues(const string& Noun)
+{
+  const uint symbol = QuerySession.Symbols.Add(Noun);
+  Properties* values = QuerySession.FindUserValues(symbol);
+  if (!values) {
+    values = &QuerySession.AddUserValues(symbol);
+    *values = QueryStory.FindPage(Noun).PageValues;
   }
-  QuerySession.ValuesChanged = true;
-  return QuerySession.UserValues[Noun];
+  return *values;
 }
 
 /** @brief return values for quick access but only for reading
   */
 const Properties& StoryQuery::GetValues(const string& Noun)
 {
-  if (QuerySession.IsUserValues(Noun)) {
-    return QuerySession.UserValues[Noun];
+  RecordRead(Noun);
+  const uint symbol = QuerySession.Symbols.Find(Noun);
+  const Properties* values = QuerySession.FindUserValues(symbol);
+  if (values) {
+    return *values;
   } else {
     return QueryStory.FindPage(Noun).PageValues;
   }
@@ -923,6 +968,7 @@ const Properties& StoryQuery::GetValues(const string& Noun)
 bool StoryQuery::GetUserTextValues(const string& Noun,
                                    Properties& Result)
 {
+  RecordRead(Noun);
   if (QuerySession.GetUserTextValues(Noun, Result)) {
     return true;
   }
@@ -937,6 +983,7 @@ bool StoryQuery::GetUserTextValues(const string& Noun,
 bool StoryQuery::GetUserInteger(const string& Noun,
                                 Properties& Result)
 {
+  RecordRead(Noun);
   if (QuerySession.GetUserInteger(Noun, Result)) {
     return true;
   }
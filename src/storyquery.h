@@ -9,7 +9,9 @@ class Story;
 class Session;
 class Dialog;
 
-struct Block;
+struct FlatBlock;
+struct VerbBlock;
+class CompiledExpressions;
 
 class StoryQuery
 {
@@ -20,31 +22,48 @@ public:
       QuerySession(Progress) { };
   ~StoryQuery() { };
 
-  szt ExecuteBlock(const string& Noun, const Block& CurBlock, cszt Level = 0);
-  bool ExecuteExpression(const string& Noun, const string& Expression,
+  szt ExecuteVerb(const string& Noun, const VerbBlock& Verb);
+  szt ExecuteVerbCode(const string& Noun, const VerbBlock& Verb);
+  szt ExecuteBlock(const string& Noun, const FlatBlock& CurBlock,
+                   const CompiledExpressions& Compiled, bool Nested);
+  bool ExecuteExpression(const string& Noun, const text_view& Expression,
                          bool Condition = false);
+  bool ExecuteExpression(const string& Noun,
+                         const CompiledExpressions& Compiled, szt Index);
 
   Properties GetVerbs(const string& Noun);
 
   Properties& GetUserValues(const string& Noun);
+  Properties& AddUserValues(const string& Noun);
   const Properties& GetValues(const string& Noun);
   bool GetUserTextValues(const string& Noun, Properties& Result);
   bool GetUserInteger(const string& Noun, Properties& Result);
 
 private:
-  bool EvaluateExpression(Properties& Result, const string& Expression,
+  void TraceBlock(const FlatBlock& CurBlock);
+  void AppendText(const text_view& Expression);
+  bool EvaluateExpression(Properties& Result,
+                          const CompiledExpressions& Compiled, uint Value,
                           bool& IsNum, bool& IsText);
-  bool ExecuteFunction(const Properties& FunctionName, Properties& FunctionArgs);
+  bool ExecuteFunction(const Properties& FunctionName, Properties& FunctionArgs,
+                       const szt* Functions = NULL);
 
   bool CreateDialog(const string& Noun, Dialog& NewDialog);
+  void RecordRead(const string& Noun);
 
 public:
   string& Text;
+  // run verbs from the compiled verb code instead of walking the blocks
+  static bool UseVerbCode;
 
 private:
   Book& QueryBook;
   Story& QueryStory;
   Session& QuerySession;
+  // while listing verbs of nouns with dynamic conditions record the nouns
+  // read and whether anything ran that can't be cached
+  vector<uint>* Reads = NULL;
+  bool SideEffects = false;
 };
 
 #endif // STORYQUERY_H
@@ -0,0 +1,32 @@
+#include "symboltable.h"
+#include <algorithm>
+
+/** @brief Find the symbol of the name, the name gets a new one if it's new
+  */
+uint SymbolTable::Add(const string& Name)
+{
+  const auto it = Symbols.find(Name);
+  if (it != Symbols.end()) {
+    return it->second;
+  }
+  const uint symbol = Names.size();
+  Symbols[Name] = symbol;
+  Names.push_back(Name);
+  return symbol;
+}
+
+/** @brief Order the symbols by their names, same order as a map by name
+  * so files written from them don't change
+  */
+void SymbolTable::SortByName(vector<uint>& List) const
+{
+  std::sort(List.begin(), List.end(), [this](uint A, uint B) {
+    return Names[A] < Names[B];
+  });
+}
+
+void SymbolTable::Clear()
+{
+  Symbols.clear();
+  Names.clear();
+}
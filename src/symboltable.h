@@ -0,0 +1,55 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include "main.h"
+#include <unordered_map>
+
+const uint NO_SYMBOL = (uint)-1;
+
+/** @brief Gives every noun name a small number so values can be kept
+  * in arrays instead of maps keyed by the name
+  *
+  * The story fills it in when it's loaded, each session starts with a copy
+  * of it and adds the names that only exist in the session.
+  */
+class SymbolTable
+{
+public:
+  SymbolTable() { };
+  ~SymbolTable() { };
+
+  uint Add(const string& Name);
+  inline uint Find(const string& Name) const;
+  inline const string& GetName(const uint Symbol) const;
+  inline szt Size() const;
+  void SortByName(vector<uint>& List) const;
+  void Clear();
+
+private:
+  std::unordered_map<string, uint> Symbols;
+  vector<string> Names;
+};
+
+/** @brief Find the symbol without adding it
+  * \return NO_SYMBOL if the name isn't known
+  */
+uint SymbolTable::Find(const string& Name) const
+{
+  const auto it = Symbols.find(Name);
+  if (it != Symbols.end()) {
+    return it->second;
+  }
+  return NO_SYMBOL;
+}
+
+const string& SymbolTable::GetName(const uint Symbol) const
+{
+  return Names[Symbol];
+}
+
+szt SymbolTable::Size() const
+{
+  return Names.size();
+}
+
+#endif // SYMBOLTABLE_H
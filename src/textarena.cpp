@@ -0,0 +1,43 @@
+#include "textarena.h"
+
+cszt ARENA_CHUNK_SIZE = 64 * 1024;
+
+/** @brief Copy the text into the arena
+  * \return view of the copy
+  */
+text_view TextArena::Add(const text_view& Text)
+{
+  if (Text.empty()) {
+    return text_view();
+  }
+  cszt size = Text.Size + 1;
+  if (Chunks.empty() || ChunkUsed + size > ChunkSize) {
+    ChunkSize = max(ARENA_CHUNK_SIZE, size);
+    ChunkUsed = 0;
+    Chunks.push_back(std::unique_ptr<char[]>(new char[ChunkSize]));
+  }
+  char* copy = Chunks.back().get() + ChunkUsed;
+  memcpy(copy, Text.Data, Text.Size);
+  copy[Text.Size] = '\0';
+  ChunkUsed += size;
+  return text_view(copy, Text.Size);
+}
+
+/** @brief Copy the part of the text between Start and End, same as CutString
+  */
+text_view TextArena::Add(const text_view& Text,
+                         cszt Start,
+                         cszt End)
+{
+  if (Start < End && Start < Text.Size) {
+    return Add(text_view(Text.Data + Start, min(End, Text.Size) - Start));
+  }
+  return text_view();
+}
+
+void TextArena::Clear()
+{
+  Chunks.clear();
+  ChunkSize = 0;
+  ChunkUsed = 0;
+}
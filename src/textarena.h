@@ -0,0 +1,29 @@
+#ifndef TEXTARENA_H
+#define TEXTARENA_H
+
+#include "main.h"
+#include <memory>
+
+/** @brief Owns the text of all the parsed pages of a story
+  *
+  * Text is copied into big chunks that never move so the views handed out
+  * stay valid until the arena is cleared. Each copy is followed by a zero
+  * so parsing functions can peek one past the end like they can on a string.
+  */
+class TextArena
+{
+public:
+  TextArena() { };
+  ~TextArena() { };
+
+  text_view Add(const text_view& Text);
+  text_view Add(const text_view& Text, cszt Start, cszt End = string::npos);
+  void Clear();
+
+private:
+  vector<std::unique_ptr<char[]>> Chunks;
+  szt ChunkSize = 0;
+  szt ChunkUsed = 0;
+};
+
+#endif // TEXTARENA_H
@@ -373,7 +373,7 @@ bool TextBox::BreakText()
   }
 
   if (skip > 0) {
-    plain = CutString(plain, 0, length - skip);
+    plain.resize(length - skip);
   }
 
   bool firstWord = true;
@@ -384,6 +384,8 @@ bool TextBox::BreakText()
   szt oldLineSkip = currentFont->GetLineSkip();
   pos = 0;
   length = plain.size();
+  // reused for every word tried so it only allocates when the line grows
+  string line;
 
   // break the text into lines that fit within the text box width
   while (pos < length) {
@@ -418,7 +420,8 @@ bool TextBox::BreakText()
     }
 
     // test print the line
-    string line = CutString(plain, lastLineEnd, pos);
+    text_view lineView = CutView(plain, lastLineEnd, pos);
+    line.assign(lineView.Data, lineView.Size);
     // did we fit in?
     if (currentFont->GetWidth(line) < PageSize.W || firstWord) {
       lastPos = pos;
@@ -426,7 +429,8 @@ bool TextBox::BreakText()
       // overflow, revert to last position and print that
       flush = true;
       pos = lastPos; // include the character so the sizes match
-      line = CutString(plain, lastLineEnd, pos);
+      lineView = CutView(plain, lastLineEnd, pos);
+      line.assign(lineView.Data, lineView.Size);
     }
 
     ++pos;
@@ -458,6 +462,7 @@ bool TextBox::BreakText()
   }
 
   lastLineEnd = 0;
+  string keywordText;
   // record visual keyword positions
   for (szt i = 0, fSz = Lines.size(); i < fSz; ++i) {
     const string& lineText = Lines[i].Text;
@@ -484,13 +489,15 @@ bool TextBox::BreakText()
         // find where the keyword starts
         newKey.Size.X = lineSize.X;
         if (beg) {
-          const string& keywordStart = CutString(lineText, 0, beg);
-          newKey.Size.X += lineFont.GetWidth(keywordStart);
+          const text_view& keywordStart = CutView(lineText, 0, beg);
+          keywordText.assign(keywordStart.Data, keywordStart.Size);
+          newKey.Size.X += lineFont.GetWidth(keywordText);
         }
         newKey.Size.Y = lineSize.Y;
         // find where the keyword ends
-        const string& keywordEnd = CutString(lineText, beg, end);
-        newKey.Size.W = lineFont.GetWidth(keywordEnd);
+        const text_view& keywordEnd = CutView(lineText, beg, end);
+        keywordText.assign(keywordEnd.Data, keywordEnd.Size);
+        newKey.Size.W = lineFont.GetWidth(keywordText);
         newKey.Size.H = lineSize.H;
         newKey.Active = activeKeywords[j];
         Keywords.push_back(newKey);
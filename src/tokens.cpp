@@ -1,4 +1,25 @@
 #include "tokens.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/** @brief Characters that remove whitespace around them, looked up by
+  * the byte instead of searching through WhitespaceRemovers
+  */
+struct WhitespaceTable {
+  WhitespaceTable()
+  {
+    for (szt i = 0; i < token::NUM_SPACE_REMOVERS; ++i) {
+      Remover[(unsigned char)token::WhitespaceRemovers[i]] = true;
+    }
+  };
+  bool Remover[256] = { };
+};
+
+static const WhitespaceTable Whitespace;
 
 /** @brief removes all whitespace around tokens and collapses multiple newlines
   */
@@ -91,14 +112,10 @@ void CleanWhitespace(string& Text)
       // we have hit a regular character
       ignoreWhite = false;
       // unless it's a whitespace remover
-      if (!inTextBlock || inKeywordBlock) {
-        for (szt i = 0; i < token::NUM_SPACE_REMOVERS; ++i) {
-          if (c == token::WhitespaceRemovers[i]) {
-            whiteCount = 0;
-            ignoreWhite = true;
-            break;
-          }
-        }
+      if ((!inTextBlock || inKeywordBlock)
+          && Whitespace.Remover[(unsigned char)c]) {
+        whiteCount = 0;
+        ignoreWhite = true;
       }
       // recover whitespace
       while (whiteCount) {
@@ -130,12 +147,119 @@ string CleanEscapeCharacters(const string& Text)
   return clean;
 }
 
+/** @brief Find the first of the two characters that isn't escaped by \,
+  * with SSE2 or AVX2 blocks of the text are compared at once and the escapes
+  * masked out of the matches
+  * \return npos if not found
+  */
+szt FindUnescaped(const text_view& Text,
+                  char A,
+                  char B,
+                  szt Start,
+                  szt End)
+{
+  const char* data = Text.Data;
+  szt pos = Start;
+
+#ifdef __AVX2__
+  const __m256i wideA = _mm256_set1_epi8(A);
+  const __m256i wideB = _mm256_set1_epi8(B);
+  const __m256i wideEscape = _mm256_set1_epi8('\\');
+  while (pos + 32 <= End) {
+    const __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + pos));
+    uint found = _mm256_movemask_epi8(
+                   _mm256_or_si256(_mm256_cmpeq_epi8(chunk, wideA),
+                                   _mm256_cmpeq_epi8(chunk, wideB)));
+    if (found) {
+      // each \ escapes the character after it, the one before the block too
+      uint escaped = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk,
+                                                            wideEscape));
+      escaped = (escaped << 1) | (pos > 0 && data[pos - 1] == '\\');
+      found &= ~escaped;
+      if (found) {
+        return pos + __builtin_ctz(found);
+      }
+    }
+    pos += 32;
+  }
+#endif
+#ifdef __SSE2__
+  const __m128i charA = _mm_set1_epi8(A);
+  const __m128i charB = _mm_set1_epi8(B);
+  const __m128i escape = _mm_set1_epi8('\\');
+  while (pos + 16 <= End) {
+    const __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+    uint found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, charA),
+                                                _mm_cmpeq_epi8(chunk, charB)));
+    if (found) {
+      uint escaped = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, escape));
+      escaped = (escaped << 1) | (pos > 0 && data[pos - 1] == '\\');
+      found &= ~escaped;
+      if (found) {
+        return pos + __builtin_ctz(found);
+      }
+    }
+    pos += 16;
+  }
+#endif
+
+  // whatever is left over or everything without SIMD
+  while (pos < End) {
+    const char c = data[pos];
+    if ((c == A || c == B) && (pos == 0 || data[pos - 1] != '\\')) {
+      return pos;
+    }
+    ++pos;
+  }
+  return string::npos;
+}
+
+/** @brief Find a two character token like += with both characters unescaped
+  * \return npos if not found
+  */
+static szt FindWideStart(const text_view& Text,
+                         char A,
+                         char B,
+                         szt Start,
+                         szt End)
+{
+  szt pos = FindUnescaped(Text, A, A, Start, End);
+  while (pos != string::npos && !IsSpecial(Text, pos + 1, B)) {
+    pos = FindUnescaped(Text, A, A, pos + 1, End);
+  }
+  return pos;
+}
+
+/** @brief Count up nested pairs from the opening character at Pos
+  * until the matching closing one
+  * \return npos if not found
+  */
+static szt FindPairEnd(const text_view& Text,
+                       char A,
+                       char B,
+                       szt Pos,
+                       szt End)
+{
+  szt matchCount = 1;
+  szt match = FindUnescaped(Text, A, B, Pos + 1, End);
+  while (match != string::npos) {
+    if (Text[match] == A) {
+      ++matchCount;
+    }
+    if (Text[match] == B && (--matchCount == 0)) {
+      return match;
+    }
+    match = FindUnescaped(Text, A, B, match + 1, End);
+  }
+  return string::npos;
+}
+
 /** @brief Find Token depending on its type, paired tokens pretend the text
   * in between is part of the token for returning position
   *
   * \return a pair of begin and end positions of the token
   */
-szt_pair FindToken(const string& Text,
+szt_pair FindToken(const text_view& Text,
                    token::tokenName TokenName,
                    szt Start,
                    szt End)
@@ -143,59 +267,46 @@ szt_pair FindToken(const string& Text,
   if (End == 0 || End > Text.size()) {
     End = Text.size();
   }
-  szt pos = Start;
-  char tokenA = token::Start[TokenName];
-  char tokenB = token::End[TokenName];
-  szt type = token::Type[TokenName];
+  const char tokenA = token::Start[TokenName];
+  const char tokenB = token::End[TokenName];
+  const szt type = token::Type[TokenName];
+  szt pos = string::npos;
+  szt match = string::npos;
 
+  // the type is only checked once and the searches jump between candidates
   if ((type & token::isPaired) && (type & token::isWide)) {
     // return if matching pair found like ** **
-    while (pos < End - 1) {
-      if (IsSpecial(Text, pos, tokenA) && IsSpecial(Text, pos + 1, tokenB)) {
-        szt match = pos;
-        while (++match < End - 1) {
-          if (IsSpecial(Text, match, tokenB)
-              && IsSpecial(Text, match + 1, tokenB)) {
-            return szt_pair(pos, match + 1);
-          }
-        }
-        break;
+    if (End > 0) {
+      pos = FindWideStart(Text, tokenA, tokenB, Start, End - 1);
+    }
+    if (pos != string::npos) {
+      match = FindWideStart(Text, tokenB, tokenB, pos + 1, End - 1);
+      if (match != string::npos) {
+        return szt_pair(pos, match + 1);
       }
-      ++pos;
     }
   } else if (type & token::isPaired) {
     // return if matching pair found like [ ]
-    while (pos < End) {
-      if (IsSpecial(Text, pos, tokenA)) {
-        szt match = pos;
-        szt matchCount = 1;
-        while (++match < End) {
-          if (IsSpecial(Text, match, tokenA)) {
-            ++matchCount;
-          }
-          if (IsSpecial(Text, match, tokenB) && (--matchCount == 0)) {
-            return szt_pair(pos, match);
-          }
-        }
-        break;
+    pos = FindUnescaped(Text, tokenA, tokenA, Start, End);
+    if (pos != string::npos) {
+      match = FindPairEnd(Text, tokenA, tokenB, pos, End);
+      if (match != string::npos) {
+        return szt_pair(pos, match);
       }
-      ++pos;
     }
   } else if (type & token::isWide) {
     // if it's two char token check for other char and return if found
-    while (pos < End - 1) {
-      if (IsSpecial(Text, pos, tokenA) && IsSpecial(Text, pos + 1, tokenB)) {
-        return szt_pair(pos, pos + 1);
-      }
-      ++pos;
+    if (End > 0) {
+      pos = FindWideStart(Text, tokenA, tokenB, Start, End - 1);
+    }
+    if (pos != string::npos) {
+      return szt_pair(pos, pos + 1);
     }
   } else {
     // if it's a single char token return when found
-    while (pos < End) {
-      if (IsSpecial(Text, pos, tokenA)) {
-        return szt_pair(pos, pos);
-      }
-      ++pos;
+    pos = FindUnescaped(Text, tokenA, tokenA, Start, End);
+    if (pos != string::npos) {
+      return szt_pair(pos, pos);
     }
   }
 
@@ -205,7 +316,7 @@ szt_pair FindToken(const string& Text,
 
 /** @brief this version only returns the start of the token, even for paired
   */
-szt FindTokenStart(const string& Text,
+szt FindTokenStart(const text_view& Text,
                    token::tokenName TokenName,
                    szt Start,
                    szt End)
@@ -213,48 +324,30 @@ szt FindTokenStart(const string& Text,
   if (End == 0 || End > Text.size()) {
     End = Text.size();
   }
-  szt pos = Start;
-  char tokenA = token::Start[TokenName];
-  char tokenB = token::End[TokenName];
-  szt type = token::Type[TokenName];
+  const char tokenA = token::Start[TokenName];
+  const char tokenB = token::End[TokenName];
+  const szt type = token::Type[TokenName];
 
-  while (pos < End) {
-    if (IsSpecial(Text, pos, tokenA)) {
-      if (type & token::isWide) {
-        // if it's two char token check for other char and return if found
-        if (IsSpecial(Text, pos + 1, tokenB)) {
-          return pos;
-        }
-      } else if (type & token::isPaired) {
-        // return if matching pair found like [ ]
-        szt match = pos;
-        szt matchCount = 1;
-
-        while (++match <= End) {
-          if (IsSpecial(Text, match, tokenA)) {
-            ++matchCount;
-          }
-          if (IsSpecial(Text, match, tokenB) && (--matchCount == 0)) {
-            return pos;
-          }
-        }
-        break;
-      } else {
-        // if it's a single char token return when found
-        return pos;
-      }
+  if (type & token::isWide) {
+    // if it's two char token check for other char and return if found
+    return FindWideStart(Text, tokenA, tokenB, Start, End);
+  } else if (type & token::isPaired) {
+    // return if matching pair found like [ ], the closing one can be at End
+    cszt pos = FindUnescaped(Text, tokenA, tokenA, Start, End);
+    if (pos != string::npos
+        && FindPairEnd(Text, tokenA, tokenB, pos, End + 1) != string::npos) {
+      return pos;
     }
-    ++pos;
+    return string::npos;
   }
-
-  // nothing found
-  return string::npos;
+  // if it's a single char token return when found
+  return FindUnescaped(Text, tokenA, tokenA, Start, End);
 }
 
 /** @brief return the end position of a token, if a token is paired it
   * will count up pairs to match so needs to start at pair start
   */
-szt FindTokenEnd(const string& Text,
+szt FindTokenEnd(const text_view& Text,
                  token::tokenName TokenName,
                  szt Start,
                  szt End)
@@ -262,39 +355,22 @@ szt FindTokenEnd(const string& Text,
   if (End == 0 || End > Text.size()) {
     End = Text.size();
   }
-  szt pos = Start;
-  char tokenA = token::Start[TokenName];
-  char tokenB = token::End[TokenName];
-  szt type = token::Type[TokenName];
+  const char tokenA = token::Start[TokenName];
+  const char tokenB = token::End[TokenName];
+  const szt type = token::Type[TokenName];
+  cszt pos = FindUnescaped(Text, tokenA, tokenA, Start, End);
 
-  while (pos < End) {
-    if (IsSpecial(Text, pos, tokenA)) {
-      if (type & token::isWide) {
-        ++pos;
-        if ((pos < End) && IsSpecial(Text, pos, tokenB)) {
-          return pos;
-        } else {
-          break;
-        }
-      } else if (type & token::isPaired) {
-        szt matchCount = 1;
-        while (++pos < End) {
-          if (IsSpecial(Text, pos, tokenA)) {
-            ++matchCount;
-          }
-          if (IsSpecial(Text, pos, tokenB) && (--matchCount == 0)) {
-            return pos;
-          }
-        }
-        break;
-      } else {
-        return pos;
-      }
+  if (pos == string::npos) {
+    return string::npos;
+  } else if (type & token::isWide) {
+    if ((pos + 1 < End) && IsSpecial(Text, pos + 1, tokenB)) {
+      return pos + 1;
     }
-    ++pos;
+    return string::npos;
+  } else if (type & token::isPaired) {
+    return FindPairEnd(Text, tokenA, tokenB, pos, End);
   }
-
-  return string::npos;
+  return pos;
 }
 
 /** @brief Removes // and everything after that from the passed in string
@@ -302,15 +378,17 @@ szt FindTokenEnd(const string& Text,
 void StripComments(string& Text)
 {
   cszt length = Text.size();
-  szt pos = 0;
-
-  while (pos < length) {
-    if (IsSpecial(Text, pos, token::Start[token::comment]) &&
-        (pos + 1 < length) && Text[pos + 1] == token::End[token::comment]) {
-      // ignore the rest of the line
-      Text = Text.substr(0, pos);
-      break;
-    }
-    ++pos;
+  if (!length) {
+    return;
+  }
+  const char commentA = token::Start[token::comment];
+  const char commentB = token::End[token::comment];
+  szt pos = FindUnescaped(Text, commentA, commentA, 0, length - 1);
+  while (pos != string::npos && Text[pos + 1] != commentB) {
+    pos = FindUnescaped(Text, commentA, commentA, pos + 1, length - 1);
+  }
+  if (pos != string::npos) {
+    // ignore the rest of the line
+    Text = Text.substr(0, pos);
   }
 }
@@ -334,18 +334,19 @@ const char WhitespaceRemovers[NUM_SPACE_REMOVERS] = {
 
 } // namespace token
 
-szt_pair FindToken(const string& Text, token::tokenName TokenName,
+szt_pair FindToken(const text_view& Text, token::tokenName TokenName,
                    szt Start = 0, szt End = 0);
-szt FindTokenStart(const string& Text, token::tokenName TokenName,
+szt FindTokenStart(const text_view& Text, token::tokenName TokenName,
                    szt Start = 0, szt End = 0);
-szt FindTokenEnd(const string& Text, token::tokenName TokenName,
+szt FindTokenEnd(const text_view& Text, token::tokenName TokenName,
                  szt Start = 0, szt End = 0);
+szt FindUnescaped(const text_view& Text, char A, char B, szt Start, szt End);
 void CleanWhitespace(string& Text);
 string CleanEscapeCharacters(const string& Text);
 void StripComments(string& Text);
 
 // handy text parsing function for escaping special chars
-inline bool IsEscaped(const string& Text, szt Pos)
+inline bool IsEscaped(const text_view& Text, szt Pos)
 {
   if (Pos > 0) {
     return (Text[Pos - 1] == '\\');
@@ -354,7 +355,7 @@ inline bool IsEscaped(const string& Text, szt Pos)
   }
 }
 
-inline bool IsSpecial(const string& Text, szt Pos, char token)
+inline bool IsSpecial(const text_view& Text, szt Pos, char token)
 {
   if ((Pos > 0) && (Text[Pos - 1] == '\\')) {
     return false;
@@ -366,7 +367,7 @@ inline bool IsSpecial(const string& Text, szt Pos, char token)
 /** @brief Find first unescaped passed in character
   * \return npos if not found
   */
-inline szt FindCharacter(const string& Text,
+inline szt FindCharacter(const text_view& Text,
                          char Char,
                          szt Start = 0,
                          szt End = 0)
@@ -374,15 +375,7 @@ inline szt FindCharacter(const string& Text,
   if (End == 0 || End > Text.size()) {
     End = Text.size();
   }
-  szt pos = Start;
-
-  while (pos < End) {
-    if (IsSpecial(Text, pos, Char)) {
-      return pos;
-    }
-    ++pos;
-  }
-  return string::npos;
+  return FindUnescaped(Text, Char, Char, Start, End);
 }
 
 inline string GetCleanWhitespace(const string& Text)
@@ -392,21 +385,30 @@ inline string GetCleanWhitespace(const string& Text)
   return clean;
 }
 
-inline bool ExtractNounVerb(const string& Text, string& Noun, string& Verb)
+inline bool ExtractNounVerb(const text_view& Text,
+                            text_view& Noun,
+                            text_view& Verb)
 {
   if (!Text.empty()) {
     cszt scopePos = FindTokenStart(Text, token::scope);
     if (scopePos != string::npos) {
-      if (scopePos) {
-        Noun = CutString(Text, 0, scopePos);
-      } else {
-        Noun.clear();
-      }
-      Verb = CutString(Text, scopePos + 1);
+      Noun = CutView(Text, 0, scopePos);
+      Verb = CutView(Text, scopePos + 1);
       return true;
     }
   }
   return false;
 }
 
+inline bool ExtractNounVerb(const string& Text, string& Noun, string& Verb)
+{
+  text_view noun, verb;
+  if (ExtractNounVerb(Text, noun, verb)) {
+    Noun.assign(noun.Data, noun.Size);
+    Verb.assign(verb.Data, verb.Size);
+    return true;
+  }
+  return false;
+}
+
 #endif // TOKEN_H
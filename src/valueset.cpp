@@ -0,0 +1,168 @@
+#include "valueset.h"
+#include <functional>
+#include <algorithm>
+
+// up to this many values a plain scan is faster than hashing
+cszt VALUESET_INDEXED = 16;
+
+/** @brief Replace the values with the list, which must not have duplicates
+  */
+ValueSet& ValueSet::operator=(const vector<string>& List)
+{
+  Values = List;
+  Reindex();
+  return *this;
+}
+
+/** @brief Position of the value in the list
+  * \return npos if not found
+  */
+szt ValueSet::Find(const string& Value) const
+{
+  if (Slots.empty()) {
+    for (szt i = 0, fSz = Values.size(); i < fSz; ++i) {
+      if (Values[i] == Value) {
+        return i;
+      }
+    }
+    return string::npos;
+  }
+
+  cszt mask = Slots.size() - 1;
+  for (szt slot = std::hash<string>()(Value) & mask; Slots[slot];
+       slot = (slot + 1) & mask) {
+    cszt index = Slots[slot] - 1;
+    if (Values[index] == Value) {
+      return index;
+    }
+  }
+  return string::npos;
+}
+
+/** @brief Add the value to the end of the list if it's not there
+  * \return false if nothing needed doing
+  */
+bool ValueSet::Add(const string& Value)
+{
+  if (Contains(Value)) {
+    return false;
+  }
+  Values.push_back(Value);
+  // keep the index at most half full
+  if (Values.size() > VALUESET_INDEXED && Values.size() * 2 > Slots.size()) {
+    Reindex();
+  } else if (!Slots.empty()) {
+    Insert(Values.size() - 1);
+  }
+  return true;
+}
+
+/** @brief Remove the value keeping the order of the rest
+  * \return false if nothing needed doing
+  */
+bool ValueSet::Remove(const string& Value)
+{
+  cszt index = Find(Value);
+  if (index == string::npos) {
+    return false;
+  }
+  Values.erase(Values.begin() + index);
+  // the positions after it have all moved
+  Reindex();
+  return true;
+}
+
+/** @brief Remove all the values found in the passed in set in one pass
+  * \return false if nothing needed doing
+  */
+bool ValueSet::RemoveAll(const ValueSet& Remove)
+{
+  if (Remove.empty()) {
+    return false;
+  }
+  if (&Remove == this) {
+    clear();
+    return true;
+  }
+  cszt oldSize = Values.size();
+  Values.erase(std::remove_if(Values.begin(), Values.end(),
+                              [&Remove](const string& Value) {
+                                return Remove.Contains(Value);
+                              }),
+               Values.end());
+  if (Values.size() == oldSize) {
+    return false;
+  }
+  Reindex();
+  return true;
+}
+
+/** @brief Remove all the values not found in the passed in set
+  * \return false if nothing needed doing
+  */
+bool ValueSet::KeepCommon(const ValueSet& Keep)
+{
+  if (&Keep == this) {
+    return false;
+  }
+  cszt oldSize = Values.size();
+  Values.erase(std::remove_if(Values.begin(), Values.end(),
+                              [&Keep](const string& Value) {
+                                return !Keep.Contains(Value);
+                              }),
+               Values.end());
+  if (Values.size() == oldSize) {
+    return false;
+  }
+  Reindex();
+  return true;
+}
+
+/** @brief Append all the suffixes in order to each of the values
+  */
+void ValueSet::AppendToAll(const ValueSet& Suffixes)
+{
+  string suffix;
+  for (const string& text : Suffixes.Values) {
+    suffix += text;
+  }
+  if (suffix.empty()) {
+    return;
+  }
+  for (string& text : Values) {
+    text += suffix;
+  }
+  Reindex();
+}
+
+/** @brief Put the position of the value in the first free slot after its hash
+  */
+void ValueSet::Insert(cszt Index)
+{
+  cszt mask = Slots.size() - 1;
+  szt slot = std::hash<string>()(Values[Index]) & mask;
+  while (Slots[slot]) {
+    slot = (slot + 1) & mask;
+  }
+  Slots[slot] = Index + 1;
+}
+
+/** @brief Rebuild the index after the positions changed, or drop it
+  * if the set is small enough to scan
+  */
+void ValueSet::Reindex()
+{
+  Slots.clear();
+  cszt count = Values.size();
+  if (count <= VALUESET_INDEXED) {
+    return;
+  }
+  szt slotCount = 16;
+  while (slotCount < count * 4) {
+    slotCount *= 2;
+  }
+  Slots.resize(slotCount, 0);
+  for (szt i = 0; i < count; ++i) {
+    Insert(i);
+  }
+}
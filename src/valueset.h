@@ -0,0 +1,101 @@
+#ifndef VALUESET_H
+#define VALUESET_H
+
+#include "main.h"
+
+/** @brief Unique text values kept in the order they were added
+  *
+  * Most values only ever hold one or two texts and scanning them is faster
+  * than hashing, so the hash index is only built once the set grows past
+  * VALUESET_INDEXED. It maps the hash of each value to its position in
+  * the list, which is what gets iterated and printed.
+  */
+class ValueSet
+{
+public:
+  typedef vector<string>::const_iterator const_iterator;
+
+  ValueSet() { };
+  ~ValueSet() { };
+
+  ValueSet& operator=(const vector<string>& List);
+
+  inline bool Contains(const string& Value) const;
+  bool Add(const string& Value);
+  bool Remove(const string& Value);
+  bool RemoveAll(const ValueSet& Remove);
+  bool KeepCommon(const ValueSet& Keep);
+  void AppendToAll(const ValueSet& Suffixes);
+
+  inline void clear();
+  inline szt size() const;
+  inline bool empty() const;
+  inline const string& operator[](cszt Index) const;
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+  inline const vector<string>& GetValues() const;
+
+private:
+  szt Find(const string& Value) const;
+  void Insert(cszt Index);
+  void Reindex();
+
+
+private:
+  vector<string> Values;
+  // positions + 1 of the values by hash, empty while the set is small
+  vector<uint> Slots;
+};
+
+/** @brief Check if a value is there
+  */
+bool ValueSet::Contains(const string& Value) const
+{
+  if (Slots.empty()) {
+    for (const string& text : Values) {
+      if (text == Value) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return Find(Value) != string::npos;
+}
+
+void ValueSet::clear()
+{
+  Values.clear();
+  Slots.clear();
+}
+
+szt ValueSet::size() const
+{
+  return Values.size();
+}
+
+bool ValueSet::empty() const
+{
+  return Values.empty();
+}
+
+const string& ValueSet::operator[](cszt Index) const
+{
+  return Values[Index];
+}
+
+ValueSet::const_iterator ValueSet::begin() const
+{
+  return Values.begin();
+}
+
+ValueSet::const_iterator ValueSet::end() const
+{
+  return Values.end();
+}
+
+const vector<string>& ValueSet::GetValues() const
+{
+  return Values;
+}
+
+#endif // VALUESET_H
@@ -0,0 +1,47 @@
+#include "workpool.h"
+#include <thread>
+#include <atomic>
+
+/** @brief Number of threads worth running, including the calling thread
+  */
+szt WorkPool::GetThreadCount()
+{
+  cszt cores = std::thread::hardware_concurrency();
+  return cores ? cores : 1;
+}
+
+/** @brief Run all the jobs and return once they're all finished
+  *
+  * The calling thread does its share of the work. If there isn't enough work
+  * to go around the jobs are simply run in order on the calling thread.
+  */
+void WorkPool::Run(cszt Count,
+                   const std::function<void(szt)>& Job,
+                   cszt MinJobsPerThread)
+{
+  szt threadCount = min(GetThreadCount(), Count / max(MinJobsPerThread, (szt)1));
+  if (threadCount < 2) {
+    for (szt i = 0; i < Count; ++i) {
+      Job(i);
+    }
+    return;
+  }
+
+  std::atomic<szt> nextJob(0);
+  auto worker = [&]() {
+    szt i;
+    while ((i = nextJob++) < Count) {
+      Job(i);
+    }
+  };
+
+  vector<std::thread> threads;
+  threads.reserve(--threadCount);
+  for (szt i = 0; i < threadCount; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include "main.h"
+#include <functional>
+
+/** @brief Spreads independent jobs over all available cores
+  *
+  * Jobs are numbered 0 to Count - 1 and picked up by whichever thread is free
+  * so the caller must make sure they don't touch shared state.
+  */
+class WorkPool
+{
+public:
+  WorkPool() { };
+  ~WorkPool() { };
+
+  static void Run(cszt Count, const std::function<void(szt)>& Job,
+                  cszt MinJobsPerThread = 1);
+  static szt GetThreadCount();
+};
+
+#endif // WORKPOOL_H
@@ -0,0 +1,106 @@
+#include "writequeue.h"
+#include "disk.h"
+
+/** @brief Finishes the writes still queued
+  */
+WriteQueue::~WriteQueue()
+{
+  {
+    std::lock_guard<std::mutex> jobsLock(JobsMutex);
+    Stopping = true;
+  }
+  JobQueued.notify_one();
+  if (Writer.joinable()) {
+    Writer.join();
+  }
+}
+
+/** @brief Add the data to the end of the file
+  */
+void WriteQueue::Append(const string& Filename, string Data)
+{
+  WriteJob job;
+  job.Filename = Filename;
+  job.Data.swap(Data);
+  job.Append = true;
+  Queue(job);
+}
+
+/** @brief Replace the file with the data, the old file stays whole until
+  * the new one is on the disk
+  */
+void WriteQueue::Replace(const string& Filename, string Data)
+{
+  WriteJob job;
+  job.Filename = Filename;
+  job.Data.swap(Data);
+  Queue(job);
+}
+
+/** @brief Wait until everything queued so far is written
+  */
+void WriteQueue::Flush()
+{
+  std::unique_lock<std::mutex> jobsLock(JobsMutex);
+  JobsDone.wait(jobsLock, [this]() {
+    return Jobs.empty() && !Writing;
+  });
+}
+
+/** @brief Check if any write failed since the last time this was called
+  */
+bool WriteQueue::TakeFailure()
+{
+  return Failed.exchange(false);
+}
+
+void WriteQueue::Queue(WriteJob& Job)
+{
+  {
+    std::lock_guard<std::mutex> jobsLock(JobsMutex);
+    Jobs.push_back(WriteJob());
+    Jobs.back().Filename.swap(Job.Filename);
+    Jobs.back().Data.swap(Job.Data);
+    Jobs.back().Append = Job.Append;
+    if (!Writer.joinable()) {
+      Writer = std::thread([this]() {
+        Run();
+      });
+    }
+  }
+  JobQueued.notify_one();
+}
+
+void WriteQueue::Run()
+{
+  std::unique_lock<std::mutex> jobsLock(JobsMutex);
+  while (true) {
+    JobQueued.wait(jobsLock, [this]() {
+      return !Jobs.empty() || Stopping;
+    });
+    if (Jobs.empty()) {
+      // only stops once everything is written
+      return;
+    }
+    WriteJob job;
+    job.Filename.swap(Jobs.front().Filename);
+    job.Data.swap(Jobs.front().Data);
+    job.Append = Jobs.front().Append;
+    Jobs.pop_front();
+    Writing = true;
+    jobsLock.unlock();
+
+    const bool written = job.Append ?
+                         Disk::AppendBinary(job.Filename, job.Data)
+                         : Disk::Replace(job.Filename, job.Data);
+    if (!written) {
+      Failed = true;
+    }
+
+    jobsLock.lock();
+    Writing = false;
+    if (Jobs.empty()) {
+      JobsDone.notify_all();
+    }
+  }
+}
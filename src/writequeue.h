@@ -0,0 +1,54 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include "main.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct WriteJob {
+  string Filename;
+  string Data;
+  bool Append = false;
+};
+
+/** @brief Writes files on a thread of its own so saving doesn't wait on
+  * the disk
+  *
+  * The data is handed over with the job so it can't change while it's
+  * being written. Jobs are done in the order they were queued, appends
+  * to a file always land after the write that created it. Anything that
+  * reads the files back needs to Flush first.
+  */
+class WriteQueue
+{
+public:
+  WriteQueue() { };
+  ~WriteQueue();
+
+  void Append(const string& Filename, string Data);
+  void Replace(const string& Filename, string Data);
+  void Flush();
+  bool TakeFailure();
+
+private:
+  void Queue(WriteJob& Job);
+  void Run();
+
+
+private:
+  std::deque<WriteJob> Jobs;
+  // a job is taken off the queue but not written yet
+  bool Writing = false;
+  bool Stopping = false;
+  std::atomic<bool> Failed{false};
+  std::mutex JobsMutex;
+  std::condition_variable JobQueued;
+  std::condition_variable JobsDone;
+  // only started with the first job
+  std::thread Writer;
+};
+
+#endif // WRITEQUEUE_H